@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace sand {
+
+// Helpers for the binary file formats. Values are written as their bytes in native
+// order, so only trivially copyable types without padding should go through them.
+
+// The magic number that reads as the given four characters from the start of a file
+constexpr auto four_cc(const char (&name)[5]) -> std::uint32_t
+{
+    return static_cast<std::uint32_t>(static_cast<unsigned char>(name[0]))
+        | static_cast<std::uint32_t>(static_cast<unsigned char>(name[1])) << 8
+        | static_cast<std::uint32_t>(static_cast<unsigned char>(name[2])) << 16
+        | static_cast<std::uint32_t>(static_cast<unsigned char>(name[3])) << 24;
+}
+
+template <typename T>
+auto write(std::ostream& out, const T& value) -> void
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Returns false if the stream ran out before the whole value was read
+template <typename T>
+auto read(std::istream& in, T& value) -> bool
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    in.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return in.gcount() == sizeof(value);
+}
+
+// Adds the bytes of value to the end of out, for records built up in memory first
+template <typename T>
+auto append(std::vector<std::uint8_t>& out, const T& value) -> void
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    const auto data = reinterpret_cast<const std::uint8_t*>(&value);
+    out.insert(out.end(), data, data + sizeof(value));
+}
+
+inline auto write_bytes(std::ostream& out, std::span<const std::uint8_t> bytes) -> void
+{
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+inline auto read_bytes(std::istream& in, std::span<std::uint8_t> bytes) -> bool
+{
+    in.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return static_cast<std::size_t>(in.gcount()) == bytes.size();
+}
+
+}
@@ -1,6 +1,10 @@
 #pragma once
+#include "geometry.hpp"
+
 #include <glm/glm.hpp>
 
+#include <cstddef>
+
 namespace sand {
 namespace config {
 
@@ -12,6 +16,23 @@ static constexpr int num_pixels = 256;
 static constexpr int chunk_size = 16;
 static_assert(num_pixels % chunk_size == 0);
 
+using geometry = static_geometry<num_pixels, num_pixels, chunk_size>;
+
+// Pixels are stored chunk by chunk, with each chunk a contiguous block. Within a
+// chunk they are either row-major or, if enabled, in Morton (Z-order) order.
+// Morton order needs the chunk size to be a power of two.
+static constexpr bool morton_tiles = false;
+
+// Level of detail. Chunks touching the viewport or near the player update every tick,
+// chunks up to these many chunks away update every 2 and 4 ticks respectively, and
+// anything further is frozen until approached.
+static constexpr int lod_half_rate_distance    = 2;
+static constexpr int lod_quarter_rate_distance = 4;
+
+// Undo. The most memory the copies of edited chunks may use, beyond which the
+// oldest edits are forgotten
+static constexpr std::size_t undo_memory_limit = 64 * 1024 * 1024;
+
 // World Space
 static constexpr int pixels_per_meter = 16;
 static constexpr int world_width = num_pixels / pixels_per_meter;
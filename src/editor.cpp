@@ -2,25 +2,25 @@
 #include "utility.hpp"
 #include "camera.hpp"
 
-#include <cereal/archives/binary.hpp>
 #include <imgui.h>
 
-#include <fstream>
 #include <format>
+#include <chrono>
 
 namespace sand {
 
 auto display_ui(
     editor& editor,
-    world& world,
-    const b2World& physics,
+    simulation& sim,
+    save_manager& saves,
+    video_playback& playback,
+    const snapshot& snap,
     const timer& timer,
     const window& window,
-    const camera& camera,
-    const player_controller& player
-) -> bool
+    const camera& camera
+) -> void
 {
-    auto updated = false;
+    const auto& world = snap.pixels;
 
     const auto mouse_actual = mouse_pos_world_space(window, camera);
     const auto mouse = pixel_at_mouse(window, camera);
@@ -47,11 +47,33 @@ auto display_ui(
 
         ImGui::Text("Info");
         ImGui::Text("FPS: %d", timer.frame_rate());
+        ImGui::Text("Tick rate: %d", snap.tick_rate);
         ImGui::Text("Awake chunks: %d", world.num_awake_chunks());
         ImGui::Checkbox("Show chunks", &editor.show_chunks);
+        if (ImGui::SliderFloat("Update budget (ms)", &editor.update_budget, 0, 16)) {
+            const auto budget = std::chrono::duration<float, std::milli>{editor.update_budget};
+            sim.push(budget_command{std::chrono::duration_cast<std::chrono::nanoseconds>(budget)});
+        }
+        if (ImGui::CollapsingHeader("Chunk lag")) {
+            // How many ticks behind each chunk is, shown as a grid of chunks
+            for (int y = 0; y != world.chunks_high(); ++y) {
+                for (int x = 0; x != world.chunks_wide(); ++x) {
+                    const auto lag = world.get_chunks()[world.get_chunk_index({x, y})].lag;
+                    if (x != 0) ImGui::SameLine();
+                    ImGui::Text("%c", lag == 0 ? '.' : lag < 10 ? static_cast<char>('0' + lag) : '+');
+                }
+            }
+        }
+        if (ImGui::CollapsingHeader("Materials")) {
+            for (std::size_t i = 0; i != num_pixel_types; ++i) {
+                const auto type = static_cast<pixel_type>(i);
+                if (const auto count = world.count(type); count > 0) {
+                    ImGui::Text("%s: %zu", to_string(type).data(), count);
+                }
+            }
+        }
         if (ImGui::Button("Clear")) {
-            world.wake_all_chunks();
-            world.fill(sand::pixel::air());
+            sim.push(clear_command{});
         }
         ImGui::Separator();
 
@@ -60,6 +82,11 @@ auto display_ui(
         if (ImGui::RadioButton("Spray", editor.brush_type == 0)) editor.brush_type = 0;
         if (ImGui::RadioButton("Square", editor.brush_type == 1)) editor.brush_type = 1;
         if (ImGui::RadioButton("Explosion", editor.brush_type == 2)) editor.brush_type = 2;
+        if (ImGui::RadioButton("Circle", editor.brush_type == 3)) editor.brush_type = 3;
+        if (ImGui::RadioButton("Flood fill", editor.brush_type == 4)) editor.brush_type = 4;
+        if (ImGui::RadioButton("Replace", editor.brush_type == 5)) editor.brush_type = 5;
+        if (ImGui::RadioButton("Copy", editor.brush_type == 6)) editor.brush_type = 6;
+        if (ImGui::RadioButton("Paste", editor.brush_type == 7)) editor.brush_type = 7;
 
         for (std::size_t i = 0; i != editor.pixel_makers.size(); ++i) {
             if (ImGui::Selectable(editor.pixel_makers[i].first.c_str(), editor.current == i)) {
@@ -67,31 +94,123 @@ auto display_ui(
             }
         }
         ImGui::Separator();
+        ImGui::BeginDisabled(!snap.can_undo);
+        if (ImGui::Button("Undo")) {
+            sim.push(undo_command{});
+        }
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        ImGui::BeginDisabled(!snap.can_redo);
+        if (ImGui::Button("Redo")) {
+            sim.push(redo_command{});
+        }
+        ImGui::EndDisabled();
+        ImGui::Separator();
+
+        ImGui::Text("Stamps");
+        if (editor.clipboard) {
+            ImGui::Text("Clipboard: %d x %d, %zu bytes", editor.clipboard->size.x, editor.clipboard->size.y,
+                        editor.clipboard->types.size() + editor.clipboard->shades.size());
+        } else {
+            ImGui::Text("Clipboard: empty");
+        }
+        ImGui::InputText("Name", editor.stamp_name.data(), editor.stamp_name.size());
+        ImGui::BeginDisabled(!editor.clipboard || editor.stamp_name[0] == '\0');
+        if (ImGui::Button("Save stamp")) {
+            editor.stamps.save(editor.stamp_name.data(), *editor.clipboard);
+        }
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        if (ImGui::Button("Refresh")) {
+            editor.stamps.refresh();
+        }
+        for (std::size_t i = 0; i != editor.stamps.names().size(); ++i) {
+            const auto& name = editor.stamps.names()[i];
+            ImGui::PushID(static_cast<int>(i));
+            if (ImGui::Button("Load")) {
+                if (auto stamp = editor.stamps.load(name)) {
+                    editor.clipboard = std::move(stamp);
+                    editor.brush_type = 7;
+                }
+            }
+            ImGui::SameLine();
+            ImGui::Text("%s", name.c_str());
+            ImGui::PopID();
+        }
+        ImGui::Separator();
         ImGui::Text("Levels");
+        ImGui::BeginDisabled(saves.busy());
         for (int i = 0; i != 5; ++i) {
             ImGui::PushID(i);
             const auto filename = std::format("save{}.bin", i);
             if (ImGui::Button("Save")) {
-                auto file = std::ofstream{filename, std::ios::binary};
-                auto archive = cereal::BinaryOutputArchive{file};
-                archive(world);
+                saves.save(world, filename);
             }
             ImGui::SameLine();
             if (ImGui::Button("Load")) {
-                auto file = std::ifstream{filename, std::ios::binary};
-                auto archive = cereal::BinaryInputArchive{file};
-                archive(world);
-                world.wake_all_chunks();
-                updated = true;
+                saves.load(filename, sim);
             }
             ImGui::SameLine();
             ImGui::Text("Save %d", i);
             ImGui::PopID();
         }
+        ImGui::EndDisabled();
+        if (ImGui::Button("Map world file")) {
+            sim.push(map_world_command{"world.sandmap"});
+        }
+        ImGui::SameLine();
+        ImGui::BeginDisabled(!snap.file_backed);
+        if (ImGui::Button("Sync")) {
+            sim.push(sync_world_command{});
+        }
+        ImGui::EndDisabled();
+        if (!snap.recording && ImGui::Button("Record")) {
+            sim.push(record_command{"session.rec"});
+        }
+        else if (snap.recording && ImGui::Button("Stop recording")) {
+            sim.push(stop_recording_command{});
+        }
+        ImGui::SliderInt("Autosave (s)", &editor.autosave_interval, 0, 300);
+        if (saves.busy()) {
+            ImGui::ProgressBar(saves.progress());
+        }
+        ImGui::Text("%s", saves.status().c_str());
+        ImGui::Separator();
+
+        ImGui::Text("Video");
+        if (!snap.recording_video && ImGui::Button("Record video")) {
+            sim.push(video_command{"session.svid"});
+        }
+        else if (snap.recording_video && ImGui::Button("Stop video")) {
+            sim.push(stop_video_command{});
+        }
+        ImGui::SameLine();
+        if (!playback.player && ImGui::Button("Open video")) {
+            // Kept between videos as the renderer only redraws what changed since its last tick
+            if (!playback.pixels) {
+                playback.pixels = std::make_unique<sand::world>();
+            }
+            playback.player = video_player::open("session.svid", *playback.pixels);
+            playback.frame = 0;
+            if (playback.player) {
+                playback.player->show(*playback.pixels);
+            }
+        }
+        else if (playback.player && ImGui::Button("Close video")) {
+            playback.player.reset();
+        }
+        if (playback.player) {
+            const auto last = static_cast<int>(playback.player->num_frames()) - 1;
+            if (ImGui::SliderInt("Frame", &playback.frame, 0, last) && playback.player->seek(playback.frame)) {
+                playback.player->show(*playback.pixels);
+            }
+            ImGui::Text("Tick %llu", static_cast<unsigned long long>(playback.player->tick()));
+            if (ImGui::Button("Export frame")) {
+                export_image(*playback.pixels, std::format("frame{}.ppm", playback.player->tick()));
+            }
+        }
     }
     ImGui::End();
-
-    return updated;
 }
     
 }
\ No newline at end of file
@@ -1,13 +1,16 @@
 #pragma once
 #include "pixel.hpp"
-#include "world.hpp"
+#include "simulation.hpp"
+#include "save_manager.hpp"
+#include "video.hpp"
+#include "stamp.hpp"
 #include "utility.hpp"
-#include "player.hpp"
 #include "graphics/window.hpp"
 
-#include <box2d/box2d.h>
-
+#include <array>
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <utility>
 #include <string>
@@ -48,8 +51,24 @@ struct editor
         // 0 == circular spray
         // 1 == square
         // 2 == explosion
+        // 3 == filled circle
+        // 4 == flood fill
+        // 5 == replace the material under the cursor
+        // 6 == copy the rectangle dragged out to the clipboard
+        // 7 == paste the clipboard centred on the cursor
         
+    std::shared_ptr<const region_stamp> clipboard;
+    std::optional<glm::ivec2>           copy_start;
+    stamp_library                       stamps{"stamps"};
+    std::array<char, 64>                stamp_name = {"stamp"};
+
     bool show_chunks = false;
+
+    // Milliseconds per tick the simulation may spend updating chunks, 0 for no limit
+    float update_budget = 0.0f;
+
+    // Seconds between autosaves, 0 for never
+    int autosave_interval = 0;
     bool show_demo = true;
     int zoom = 256;
     
@@ -59,15 +78,16 @@ struct editor
     }
 };
 
-// Returns true if the world has changed and should be rerendered
+// Displays the latest snapshot of the simulation, any edits are pushed to it as commands
 auto display_ui(
     editor& editor,
-    world& world,
-    const b2World& physics,
+    simulation& sim,
+    save_manager& saves,
+    video_playback& playback,
+    const snapshot& snap,
     const timer& timer,
     const window& window,
-    const camera& camera,
-    const player_controller& player
-) -> bool;
+    const camera& camera
+) -> void;
 
 }
\ No newline at end of file
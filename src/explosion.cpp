@@ -1,61 +1,136 @@
 #include "explosion.hpp"
 #include "utility.hpp"
+#include "job_system.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtx/norm.hpp>
 
-#include <unordered_set>
-
 namespace sand {
 namespace {
 
-auto explosion_ray(world& pixels, glm::vec2 start, glm::vec2 end, const explosion& info) -> void
+// The blast part of a ray, worked out up front so that rays can be traced in parallel
+struct explosion_ray
+{
+    glm::vec2 start;
+    glm::vec2 step;
+    int       blast_steps;
+    float     scorch_limit;
+};
+
+// The random parts of a ray, rolled on the calling thread before tracing so that an
+// explosion comes out the same for a given seed however the rays are shared out
+struct ray_rolls
+{
+    float blast_limit;
+    float scorch;
+};
+
+// Read only, explosions never create titanium so tracing against the world as it was
+// before any ray is applied finds the same blast path as tracing them one by one.
+auto trace_ray(const auto& pixels, glm::vec2 start, glm::vec2 end, const ray_rolls& rolls) -> explosion_ray
 {
     // Calculate a step length small enough to hit every pixel on the path.
     const auto line = end - start;
     const auto step = line / glm::max(glm::abs(line.x), glm::abs(line.y));
 
     auto curr = start;
+    auto blast_steps = 0;
 
-    const auto blast_limit = random_from_range(info.min_radius, info.max_radius);
+    const auto blast_limit = rolls.blast_limit;
     while (pixels.valid(curr) && glm::length2(curr - start) < glm::pow(blast_limit, 2)) {
         if (pixels.at(curr).type == pixel_type::titanium) {
             break;
         }
-        pixels.set(curr, random_unit() < 0.05f ? pixel::ember() : pixel::air());
+        ++blast_steps;
         curr += step;
     }
+
+    const auto scorch_limit = glm::length(curr - start) + rolls.scorch;
+    return {start, step, blast_steps, scorch_limit};
+}
+
+auto apply_ray(auto& pixels, const explosion_ray& ray) -> void
+{
+    static constexpr auto leaves_ember = probability{0.05f};
+
+    auto curr = ray.start;
+    for (int i = 0; i != ray.blast_steps; ++i) {
+        pixels.set(curr, roll(leaves_ember) ? pixel::ember() : pixel::air());
+        curr += ray.step;
+    }
     
     // Try to catch light to the first scorched pixel
     if (pixels.valid(curr)) {
         auto& pixel = pixels.at(curr);
-        if (random_unit() < properties(pixel).flammability) {
+        if (roll(chances(pixel).ignite)) {
             pixel.flags[is_burning] = true;
             pixels.wake_chunk_with_pixel(curr);
         }
     }
 
-    const auto scorch_limit = glm::length(curr - start) + std::abs(random_normal(0.0f, info.scorch));
-    while (pixels.valid(curr) && glm::length2(curr - start) < glm::pow(scorch_limit, 2)) {
-        if (properties(pixels.at(curr)).phase == pixel_phase::solid) {
-            pixels.at(curr).colour *= 0.8f;
+    while (pixels.valid(curr) && glm::length2(curr - ray.start) < glm::pow(ray.scorch_limit, 2)) {
+        if (auto& scorched = pixels.at(curr); properties(scorched).phase == pixel_phase::solid) {
+            scorched.colour *= 0.8f;
+            scorched.shade = to_shade(scorched);
             pixels.wake_chunk_with_pixel(curr);
         }
-        curr += step;
+        curr += ray.step;
+    }
+}
+
+// Tracing is the expensive part, so is handed to for_each_range which may run it in
+// parallel. The rays are then applied in order as they overlap near the centre
+auto resolve_explosion(auto& pixels, glm::vec2 pos, const explosion& info, auto&& for_each_range) -> void
+{
+    const auto a = static_cast<int>(info.max_radius + 3 * info.scorch);
+    const auto rays_per_side = static_cast<std::size_t>(2 * a + 1);
+
+    auto& scratch = job_system::scratch();
+    const auto scope = scratch_scope{scratch};
+    auto rays = scratch.allocate<explosion_ray>(4 * rays_per_side);
+    auto rolls = scratch.allocate<ray_rolls>(4 * rays_per_side);
+    for (auto& roll : rolls) {
+        roll.blast_limit = random_from_range(info.min_radius, info.max_radius);
+        roll.scorch = std::abs(random_normal(0.0f, info.scorch));
+    }
+
+    const auto& world = pixels;
+    for_each_range(rays_per_side, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i != end; ++i) {
+            const auto b = static_cast<int>(i) - a;
+            rays[4 * i + 0] = trace_ray(world, pos, pos + glm::vec2{b, a}, rolls[4 * i + 0]);
+            rays[4 * i + 1] = trace_ray(world, pos, pos + glm::vec2{b, -a}, rolls[4 * i + 1]);
+            rays[4 * i + 2] = trace_ray(world, pos, pos + glm::vec2{a, b}, rolls[4 * i + 2]);
+            rays[4 * i + 3] = trace_ray(world, pos, pos + glm::vec2{-a, b}, rolls[4 * i + 3]);
+        }
+    });
+
+    for (const auto& ray : rays) {
+        apply_ray(pixels, ray);
     }
 }
 
 }
 
-auto apply_explosion(world& pixels, glm::vec2 pos, const explosion& info) -> void
+template <typename Geometry>
+auto apply_explosion(basic_world<Geometry>& pixels, glm::vec2 pos, const explosion& info) -> void
 {
-    const auto a = info.max_radius + 3 * info.scorch;
-    for (int b = -a; b != a + 1; ++b) {
-        explosion_ray(pixels, pos, pos + glm::vec2{b, a}, info);
-        explosion_ray(pixels, pos, pos + glm::vec2{b, -a}, info);
-        explosion_ray(pixels, pos, pos + glm::vec2{a, b}, info);
-        explosion_ray(pixels, pos, pos + glm::vec2{-a, b}, info);
-    }
+    resolve_explosion(pixels, pos, info, [](std::size_t count, auto&& trace) {
+        trace(0, count);
+    });
+}
+
+template <typename Geometry>
+auto apply_explosion(basic_world<Geometry>& pixels, glm::vec2 pos, const explosion& info, job_system& jobs) -> void
+{
+    resolve_explosion(pixels, pos, info, [&](std::size_t count, auto&& trace) {
+        jobs.parallel_for(count, 32, trace);
+    });
 }
 
-}
\ No newline at end of file
+template auto apply_explosion(basic_world<sand::config::geometry>&, glm::vec2, const explosion&) -> void;
+template auto apply_explosion(basic_world<dynamic_geometry>&, glm::vec2, const explosion&) -> void;
+template auto apply_explosion(basic_world<sand::config::geometry>&, glm::vec2, const explosion&, job_system&) -> void;
+template auto apply_explosion(basic_world<dynamic_geometry>&, glm::vec2, const explosion&, job_system&) -> void;
+
+}
@@ -16,6 +16,15 @@ struct explosion
     float scorch;
 };
 
-auto apply_explosion(world& pixels, glm::vec2 pos, const explosion& info) -> void;
+class job_system;
+
+// Resolves the explosion entirely on the calling thread. Used for the small explosions
+// set off during an update, where handing out the rays would cost more than it saves
+template <typename Geometry>
+auto apply_explosion(basic_world<Geometry>& pixels, glm::vec2 pos, const explosion& info) -> void;
+
+// Rays are traced on the job system, then applied to the world on the calling thread
+template <typename Geometry>
+auto apply_explosion(basic_world<Geometry>& pixels, glm::vec2 pos, const explosion& info, job_system& jobs) -> void;
 
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+#include <cassert>
+
+namespace sand {
+
+// Geometry policies give the size of a world in pixels and the size of its chunks.
+// The world, update and renderer are templated on them. static_geometry has every
+// dimension as a compile time constant, so the index maths folds down to shifts and
+// masks for power of two sizes. dynamic_geometry is for sizes only known at runtime.
+template <int Width, int Height, int ChunkSize>
+struct static_geometry
+{
+    static_assert(Width % ChunkSize == 0);
+    static_assert(Height % ChunkSize == 0);
+
+    static constexpr auto width() -> int { return Width; }
+    static constexpr auto height() -> int { return Height; }
+    static constexpr auto chunk_size() -> int { return ChunkSize; }
+
+    static constexpr auto chunks_wide() -> int { return Width / ChunkSize; }
+    static constexpr auto chunks_high() -> int { return Height / ChunkSize; }
+};
+
+class dynamic_geometry
+{
+    int d_width;
+    int d_height;
+    int d_chunk_size;
+
+public:
+    dynamic_geometry(int width, int height, int chunk_size)
+        : d_width{width}
+        , d_height{height}
+        , d_chunk_size{chunk_size}
+    {
+        assert(width % chunk_size == 0);
+        assert(height % chunk_size == 0);
+    }
+
+    auto width() const -> int { return d_width; }
+    auto height() const -> int { return d_height; }
+    auto chunk_size() const -> int { return d_chunk_size; }
+
+    auto chunks_wide() const -> int { return d_width / d_chunk_size; }
+    auto chunks_high() const -> int { return d_height / d_chunk_size; }
+};
+
+}
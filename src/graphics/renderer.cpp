@@ -2,11 +2,17 @@
 #include "utility.hpp"
 #include "pixel.hpp"
 #include "camera.hpp"
+#include "job_system.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/glm.hpp>
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+
 namespace sand {
 namespace {
 
@@ -18,13 +24,13 @@ uniform mat4  u_proj_matrix;
 uniform vec2  u_tex_offset;
 uniform float u_world_to_screen;
 
-uniform sampler2D u_texture;
+uniform usampler2D u_state;
 
 out vec2 pass_uv;
 
 void main()
 {
-    vec2 tex_size = vec2(textureSize(u_texture, 0));
+    vec2 tex_size = vec2(textureSize(u_state, 0));
     vec2 position = (p_position * tex_size - u_tex_offset)
                   * u_world_to_screen;
 
@@ -33,43 +39,149 @@ void main()
 }
 )SHADER";
 
+// Each cell of u_state is its type, shade, power and flags. Colours are the type's
+// palette entry scaled by the shade, with burning pixels and powered electronics
+// animated here rather than recoloured on the CPU.
 constexpr auto fragment_shader = R"SHADER(
 #version 410 core
 layout (location = 0) out vec4 out_colour;
 
 in vec2 pass_uv;
 
-uniform sampler2D u_texture;
+uniform usampler2D u_state;
+uniform usampler2D u_chunks;
+
+uniform vec4 u_palette[32];
+uniform vec4 u_materials[32]; // x is the power type, y the maximum power
+uniform vec4 u_fire[3];
+uniform vec4 u_electricity[2];
+
+uniform int u_chunk_size;
+uniform int u_show_chunks;
+uniform int u_frame;
+
+const uint burning_bit = 1u;
+const float power_source = 1.0;
+const float power_conductor = 2.0;
+
+// Picks the animation colour for a cell, changing every frame
+uint noise(ivec2 cell)
+{
+    uint h = uint(cell.x) * 0x8da6b343u ^ uint(cell.y) * 0xd8163841u ^ uint(u_frame) * 0xcb1ab31fu;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return h;
+}
 
 void main()
 {
-    out_colour = texture(u_texture, pass_uv);
+    ivec2 size = textureSize(u_state, 0);
+    ivec2 cell = min(ivec2(pass_uv * vec2(size)), size - 1);
+    uvec4 state = texelFetch(u_state, cell, 0);
+
+    vec4 colour = vec4(u_palette[state.r].rgb * (float(state.g) / 128.0), 1.0);
+    vec4 material = u_materials[state.r];
+    float power = material.y > 0.0 ? float(state.b) / material.y : 0.0;
+
+    if ((state.a & burning_bit) != 0u) {
+        colour = u_fire[noise(cell) % 3u];
+    }
+    else if (material.x == power_source) {
+        colour = mix(vec4(0.0, 0.0, 0.0, 1.0), colour, power);
+    }
+    else if (material.x == power_conductor) {
+        colour = mix(colour, u_electricity[noise(cell) % 2u], power);
+    }
+
+    // Awake chunks are lightened and chunks behind on their updates are tinted red
+    if (u_show_chunks != 0) {
+        uvec4 chunk = texelFetch(u_chunks, cell / u_chunk_size, 0);
+        if (chunk.r != 0u) {
+            colour.rgb += vec3(0.05);
+        }
+        colour.r += 0.02 * float(chunk.g);
+    }
+
+    out_colour = colour;
 }
 )SHADER";
 
-auto get_pos(glm::vec2 pos) -> std::size_t
+static constexpr std::uint32_t burning_bit = 1;
+
+// Lag beyond this shows as the same tint
+static constexpr int max_shown_lag = 10;
+
+static constexpr std::size_t palette_size = 32;
+static_assert(num_pixel_types <= palette_size);
+
+// Type, shade, power and flags, a byte each with the type lowest, matching
+// GL_UNSIGNED_INT_8_8_8_8_REV
+auto pack_state(const pixel& px) -> std::uint32_t
 {
-    return pos.x + sand::config::num_pixels * pos.y;
+    const auto flags = px.flags[is_burning] ? burning_bit : 0;
+    return static_cast<std::uint32_t>(px.type)
+         | (std::uint32_t{px.shade} << 8)
+         | (std::uint32_t{px.power} << 16)
+         | (flags << 24);
 }
 
-auto light_noise(glm::vec4 vec) -> glm::vec4
+auto pack_chunk(const chunk& c) -> std::uint32_t
 {
-    return {
-        std::clamp(vec.x + sand::random_from_range(-0.04f, 0.04f), 0.0f, 1.0f),
-        std::clamp(vec.y + sand::random_from_range(-0.04f, 0.04f), 0.0f, 1.0f),
-        std::clamp(vec.z + sand::random_from_range(-0.04f, 0.04f), 0.0f, 1.0f),
-        1.0f
-    };
+    return (c.should_step ? 1u : 0u) | (static_cast<std::uint32_t>(std::min(c.lag, max_shown_lag)) << 8);
+}
+
+// A rectangle of chunks, inclusive
+struct chunk_rect
+{
+    glm::ivec2 first;
+    glm::ivec2 last;
+};
+
+// Merges the dirty chunks into rectangles, first into runs along each row of chunks and
+// then runs covering the same columns in consecutive rows, so that an active area is
+// uploaded in a few calls rather than one per chunk. Returns the number of rectangles.
+auto merge_dirty(
+    std::span<const std::uint8_t> dirty,
+    int chunks_wide,
+    std::span<chunk_rect> rects,
+    std::span<std::size_t> open
+) -> std::size_t
+{
+    // open[x] is one past the rectangle last started at column x, if any
+    std::ranges::fill(open, 0);
+    auto num_rects = std::size_t{0};
+    const auto chunks_high = static_cast<int>(dirty.size()) / chunks_wide;
+    for (int y = 0; y != chunks_high; ++y) {
+        const auto row = dirty.subspan(static_cast<std::size_t>(y) * chunks_wide, chunks_wide);
+        for (int x = 0; x != chunks_wide;) {
+            if (!row[x]) { ++x; continue; }
+            auto end = x + 1;
+            while (end != chunks_wide && row[end]) ++end;
+
+            if (open[x] != 0 && rects[open[x] - 1].last == glm::ivec2{end - 1, y - 1}) {
+                rects[open[x] - 1].last.y = y;
+            } else {
+                rects[num_rects++] = {.first = {x, y}, .last = {end - 1, y}};
+                open[x] = num_rects;
+            }
+            x = end;
+        }
+    }
+    return num_rects;
 }
 
 }
 
-renderer::renderer()
-    : d_vao{0}
+renderer::renderer(job_system& jobs)
+    : d_jobs{&jobs}
+    , d_vao{0}
     , d_vbo{0}
     , d_ebo{0}
     , d_texture{}
-    , d_texture_data{}
+    , d_uploads{}
+    , d_chunk_texture{}
+    , d_chunk_data{}
     , d_shader{vertex_shader, fragment_shader}
 {
     const float vertices[] = {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
@@ -90,7 +202,29 @@ renderer::renderer()
     glEnableVertexAttribArray(0);
 
     d_shader.bind();
-    d_shader.load_sampler("u_texture", 0);
+    d_shader.load_sampler("u_state", 0);
+    d_shader.load_sampler("u_chunks", 1);
+
+    // The material table never changes, so it is uploaded once
+    auto palette = std::array<glm::vec4, palette_size>{};
+    auto materials = std::array<glm::vec4, palette_size>{};
+    for (std::size_t i = 0; i != num_pixel_types; ++i) {
+        const auto type = static_cast<pixel_type>(i);
+        const auto props = properties(type);
+        palette[i] = base_colour(type);
+        materials[i] = {static_cast<float>(props.power_type), static_cast<float>(props.power_max), 0.0f, 0.0f};
+    }
+    d_shader.load_vec4_array("u_palette", palette);
+    d_shader.load_vec4_array("u_materials", materials);
+
+    const auto fire_colours = std::array{
+        from_hex(0xe55039), from_hex(0xf6b93b), from_hex(0xfad390)
+    };
+    const auto electricity_colours = std::array{
+        from_hex(0xf6e58d), from_hex(0xf9ca24)
+    };
+    d_shader.load_vec4_array("u_fire", fire_colours);
+    d_shader.load_vec4_array("u_electricity", electricity_colours);
 
     resize(sand::config::num_pixels, sand::config::num_pixels);
 }
@@ -108,15 +242,15 @@ auto renderer::bind() const -> void
     d_shader.bind();
 }
 
-auto renderer::update(const world& world, bool show_chunks, const camera& camera) -> void
+template <typename Geometry>
+auto renderer::update(const basic_world<Geometry>& world, bool show_chunks, const camera& camera) -> void
 {
-    static const auto fire_colours = std::array{
-        from_hex(0xe55039), from_hex(0xf6b93b), from_hex(0xfad390)
-    };
-
-    static const auto electricity_colours = std::array{
-        from_hex(0xf6e58d), from_hex(0xf9ca24)
-    };
+    const auto width = static_cast<std::uint32_t>(world.width());
+    const auto height = static_cast<std::uint32_t>(world.height());
+    if (d_texture.width() != width || d_texture.height() != height) {
+        resize(width, height);
+        d_next_tick = 0;
+    }
 
     d_shader.load_vec2("u_tex_offset", camera.top_left);
     d_shader.load_float("u_world_to_screen", camera.world_to_screen);
@@ -124,58 +258,103 @@ auto renderer::update(const world& world, bool show_chunks, const camera& camera
     const auto projection = glm::ortho(0.0f, camera.screen_width, camera.screen_height, 0.0f);
     d_shader.load_mat4("u_proj_matrix", projection);
 
-    const auto& chunks = world.get_chunks();
-    for (std::size_t index = 0; index != chunks.size(); ++index) {
-        if (!chunks[index].should_step && !show_chunks) continue;
+    d_shader.load_int("u_frame", static_cast<int>(d_frame++));
+    d_shader.load_int("u_chunk_size", world.chunk_size());
+    d_shader.load_int("u_show_chunks", show_chunks ? 1 : 0);
 
-        const auto top_left = sand::config::chunk_size * get_chunk_pos(index);
-        for (std::size_t x = 0; x != sand::config::chunk_size; ++x) {
-            for (std::size_t y = 0; y != sand::config::chunk_size; ++y) {
-                const auto world_coord = top_left + glm::ivec2{x, y};
+    const auto& chunks = world.get_chunks();
 
-                auto& colour = d_texture_data[world_coord.x + d_texture.width() * world_coord.y];
+    // The overlay is a texel per chunk, small enough to send whole
+    if (show_chunks) {
+        const auto chunks_wide = static_cast<std::uint32_t>(world.chunks_wide());
+        const auto chunks_high = static_cast<std::uint32_t>(world.chunks_high());
+        if (d_chunk_texture.width() != chunks_wide || d_chunk_texture.height() != chunks_high) {
+            d_chunk_texture.resize(chunks_wide, chunks_high);
+            d_chunk_data.resize(chunks.size());
+        }
+        std::ranges::transform(chunks, d_chunk_data.begin(), pack_chunk);
+        d_chunk_texture.set_data(d_chunk_data);
+    }
 
-                const auto& pixel = world.at(world_coord);
-                const auto& props = properties(pixel);
+    auto& scratch = job_system::scratch();
+    const auto scope = scratch_scope{scratch};
+    auto dirty = scratch.allocate<std::size_t>(chunks.size());
+    auto is_dirty = scratch.allocate<std::uint8_t>(chunks.size());
+    auto num_dirty = std::size_t{0};
+    for (std::size_t index = 0; index != chunks.size(); ++index) {
+        is_dirty[index] = chunks[index].awake_tick >= d_next_tick;
+        if (is_dirty[index]) {
+            dirty[num_dirty++] = index;
+        }
+    }
+    d_next_tick = world.tick() + 1;
+    if (num_dirty == 0) {
+        return;
+    }
 
-                if (pixel.flags[is_burning]) {
-                    colour = sand::random_element(fire_colours);
-                }
-                else if (props.power_type == pixel_power_type::source) {
-                    const auto a = from_hex(0x000000); // black
-                    const auto b = pixel.colour;
-                    const auto t = static_cast<float>(pixel.power) / props.power_max;
-                    colour = sand::lerp(a, b, t);
-                }
-                else if (props.power_type == pixel_power_type::conductor) {
-                    const auto a = pixel.colour;
-                    const auto b = sand::random_element(electricity_colours);
-                    const auto t = static_cast<float>(pixel.power) / props.power_max;
-                    colour = sand::lerp(a, b, t);
-                }
-                else {
-                    colour = pixel.colour;
-                }
+    auto rects = scratch.allocate<chunk_rect>(num_dirty);
+    auto open = scratch.allocate<std::size_t>(world.chunks_wide());
+    const auto num_rects = merge_dirty(is_dirty, world.chunks_wide(), rects, open);
+
+    // Each rectangle's rows are packed one after another, rectangle after rectangle, so
+    // the texels of a chunk go to its rectangle's offset plus its place within it
+    const auto chunk_size = world.chunk_size();
+    auto offsets = scratch.allocate<std::size_t>(num_rects);
+    auto rect_of = scratch.allocate<std::uint32_t>(chunks.size());
+    auto total = std::size_t{0};
+    for (std::size_t i = 0; i != num_rects; ++i) {
+        const auto& rect = rects[i];
+        offsets[i] = total;
+        const auto size = (rect.last - rect.first + 1) * chunk_size;
+        total += static_cast<std::size_t>(size.x) * size.y;
+        for (int y = rect.first.y; y <= rect.last.y; ++y) {
+            for (int x = rect.first.x; x <= rect.last.x; ++x) {
+                rect_of[world.get_chunk_index({x, y})] = static_cast<std::uint32_t>(i);
+            }
+        }
+    }
 
-                if (show_chunks && chunks[index].should_step) {
-                    colour += glm::vec4{0.05, 0.05, 0.05, 0};
+    // Chunks cover disjoint parts of the upload so can be packed in parallel
+    const auto texels = d_uploads.begin_frame();
+    d_jobs->parallel_for(num_dirty, 8, [&](std::size_t begin, std::size_t end) {
+        for (const auto index : dirty.subspan(begin, end - begin)) {
+            const auto& rect = rects[rect_of[index]];
+            const auto rect_width = (rect.last.x - rect.first.x + 1) * chunk_size;
+            const auto local = (world.get_chunk_pos(index) - rect.first) * chunk_size;
+            const auto top_left = world.get_chunk_pos(index) * chunk_size;
+            for (int y = 0; y != chunk_size; ++y) {
+                const auto row = texels.subspan(offsets[rect_of[index]] + local.x + static_cast<std::size_t>(rect_width) * (local.y + y), chunk_size);
+                for (int x = 0; x != chunk_size; ++x) {
+                    row[x] = pack_state(world.at(top_left + glm::ivec2{x, y}));
                 }
             }
         }
-    }
+    });
 
-    d_texture.set_data(d_texture_data);
+    for (std::size_t i = 0; i != num_rects; ++i) {
+        const auto& rect = rects[i];
+        d_uploads.upload(d_texture, offsets[i], rect.first * chunk_size, (rect.last - rect.first + 1) * chunk_size);
+    }
+    d_uploads.end_frame();
 }
 
+template auto renderer::update(const basic_world<sand::config::geometry>&, bool, const camera&) -> void;
+template auto renderer::update(const basic_world<dynamic_geometry>&, bool, const camera&) -> void;
+
 auto renderer::draw() const -> void
 {
+    // Uploads bind whichever texture they write to, so both are rebound here
+    glActiveTexture(GL_TEXTURE1);
+    d_chunk_texture.bind();
+    glActiveTexture(GL_TEXTURE0);
+    d_texture.bind();
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
 }
 
 auto renderer::resize(std::uint32_t width, std::uint32_t height) -> void
 {
     d_texture.resize(width, height);
-    d_texture_data.resize(width * height);
+    d_uploads.reserve(static_cast<std::size_t>(width) * height);
 }
 
-}
\ No newline at end of file
+}
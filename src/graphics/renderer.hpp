@@ -1,25 +1,45 @@
 #pragma once
 #include "graphics/texture.hpp"
 #include "graphics/shader.hpp"
+#include "graphics/upload_ring.hpp"
 #include "world.hpp"
 #include "camera.hpp"
 
 #include <glm/glm.hpp>
 
-#include <memory>
 #include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 namespace sand {
 
-// Responsible for rendering the world to the screen.
+class job_system;
+
+// Responsible for rendering the world to the screen. What is uploaded is four bytes of
+// state per pixel, the colours, including burning and powered pixels, are worked out
+// by the fragment shader.
 class renderer
 {
+    job_system*   d_jobs;
     std::uint32_t d_vao;
     std::uint32_t d_vbo;
     std::uint32_t d_ebo;
 
-    texture                d_texture;
-    std::vector<glm::vec4> d_texture_data;
+    // The state of each pixel, which the shader turns into a colour. Changed chunks are
+    // packed straight into the upload ring's memory each frame
+    texture     d_texture;
+    upload_ring d_uploads;
+
+    // Whether each chunk is awake and how far behind it is, for the show_chunks overlay
+    texture                    d_chunk_texture;
+    std::vector<std::uint32_t> d_chunk_data;
+
+    // Animations change every frame drawn
+    std::uint32_t d_frame = 0;
+
+    // Chunks last awake before this world tick are already up to date in the texture
+    std::uint64_t d_next_tick = 0;
 
     shader d_shader;
 
@@ -27,12 +47,16 @@ class renderer
     renderer& operator=(const renderer&) = delete;
 
 public:
-    renderer();
+    explicit renderer(job_system& jobs);
     ~renderer();
 
     auto bind() const -> void;
 
-    auto update(const world& world, bool show_chunks, const camera& camera) -> void;
+    // Redraws the chunks that have changed since the last call and resizes the texture
+    // to match the world if needed. Cheap to call every frame with the same world, only
+    // the changed chunks are uploaded
+    template <typename Geometry>
+    auto update(const basic_world<Geometry>& world, bool show_chunks, const camera& camera) -> void;
 
     auto draw() const -> void;
 
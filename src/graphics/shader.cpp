@@ -80,6 +80,11 @@ auto shader::load_vec4(const char* name, const glm::vec4& vector) const -> void
 	glUniform4f(get_location(name), vector.x, vector.y, vector.z, vector.w);
 }
 
+auto shader::load_vec4_array(const char* name, std::span<const glm::vec4> vectors) const -> void
+{
+	glUniform4fv(get_location(name), static_cast<GLsizei>(vectors.size()), &vectors.front().x);
+}
+
 auto shader::load_sampler(const char* name, int value) const -> void
 {
 	glProgramUniform1i(d_program, get_location(name), value);
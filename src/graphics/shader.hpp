@@ -2,6 +2,7 @@
 #include <glm/glm.hpp>
 
 #include <cstdint>
+#include <span>
 #include <string>
 #include <filesystem>
 
@@ -26,6 +27,7 @@ public:
     auto load_vec2(const char* name, const glm::vec2& vector) const -> void;
     auto load_vec3(const char* name, const glm::vec3& vector) const -> void;
     auto load_vec4(const char* name, const glm::vec4& vector) const -> void;
+    auto load_vec4_array(const char* name, std::span<const glm::vec4> vectors) const -> void;
     auto load_int(const char* name, int value) const -> void;
     auto load_float(const char* name, float value) const -> void;
     auto load_sampler(const char* name, int value) const -> void;
@@ -13,6 +13,9 @@ texture::texture(std::uint32_t width, std::uint32_t height)
 }
 
 texture::texture()
+    : d_texture{0}
+    , d_width{0}
+    , d_height{0}
 {}
 
 texture::~texture()
@@ -20,11 +23,19 @@ texture::~texture()
     glDeleteTextures(1, &d_texture);
 }
 
-auto texture::set_data(std::span<const glm::vec4> data) -> void
+auto texture::set_data(std::span<const std::uint32_t> data) -> void
 {
     assert(data.size() == d_width * d_height);
     bind();
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, d_width, d_height, 0, GL_RGBA, GL_FLOAT, data.data());
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, d_width, d_height, GL_RGBA_INTEGER, GL_UNSIGNED_INT_8_8_8_8_REV, data.data());
+}
+
+auto texture::set_region(glm::ivec2 top_left, glm::ivec2 size, const std::uint32_t* texels) -> void
+{
+    assert(top_left.x >= 0 && top_left.y >= 0);
+    assert(top_left.x + size.x <= static_cast<int>(d_width) && top_left.y + size.y <= static_cast<int>(d_height));
+    bind();
+    glTexSubImage2D(GL_TEXTURE_2D, 0, top_left.x, top_left.y, size.x, size.y, GL_RGBA_INTEGER, GL_UNSIGNED_INT_8_8_8_8_REV, texels);
 }
 
 auto texture::bind() const -> void
@@ -47,7 +58,7 @@ auto texture::resize(std::uint32_t width, std::uint32_t height) -> void
     glTextureParameteri(d_texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTextureParameteri(d_texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTextureParameteri(d_texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8UI, width, height);
 }
 
 }
\ No newline at end of file
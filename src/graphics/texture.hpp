@@ -6,6 +6,8 @@
 
 namespace sand {
 
+// An RGBA8UI texture, four unsigned bytes per texel read as integers by shaders, whose
+// storage is allocated once per size. Texels are packed with the first byte lowest.
 class texture
 {
     std::uint32_t d_texture;
@@ -20,9 +22,14 @@ public:
     texture(std::uint32_t width, std::uint32_t height);
     ~texture();
 
-    auto set_data(std::span<const glm::vec4> data) -> void;
+    auto set_data(std::span<const std::uint32_t> data) -> void;
+
+    // Uploads just the given rectangle from texels, its rows packed one after another. With
+    // a pixel unpack buffer bound, texels is an offset into that instead
+    auto set_region(glm::ivec2 top_left, glm::ivec2 size, const std::uint32_t* texels) -> void;
     auto bind() const -> void;
 
+    // Recreates the texture, as its storage is immutable. The contents are undefined until set
     auto resize(std::uint32_t width, std::uint32_t height) -> void;
 
     auto width() const -> std::uint32_t { return d_width; }
@@ -0,0 +1,130 @@
+#include "upload_ring.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <print>
+
+namespace sand {
+namespace {
+
+// Enough for the GPU to be a frame behind with one more being written
+static constexpr std::size_t num_slots = 3;
+
+static constexpr GLbitfield map_flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+// Fences are waited on for this long at a time, the driver is only flushed on the first
+static constexpr GLuint64 fence_timeout_ns = 1'000'000'000;
+
+}
+
+struct upload_ring::slot
+{
+    GLuint         buffer = 0;
+    std::uint32_t* texels = nullptr;
+    GLsync         fence  = nullptr;
+};
+
+upload_ring::upload_ring()
+    : d_persistent{GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage}
+{
+    if (!d_persistent) {
+        std::print("ARB_buffer_storage is not available, texture uploads will not be streamed\n");
+    }
+}
+
+upload_ring::~upload_ring()
+{
+    release();
+}
+
+auto upload_ring::release() -> void
+{
+    // Deleting a buffer the GPU is still reading from is deferred by the driver
+    for (auto& slot : d_slots) {
+        if (slot.fence) glDeleteSync(slot.fence);
+        if (slot.texels) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        glDeleteBuffers(1, &slot.buffer);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    d_slots.clear();
+    d_current = 0;
+}
+
+auto upload_ring::reserve(std::size_t capacity) -> void
+{
+    if (capacity <= d_capacity) {
+        return;
+    }
+    d_capacity = capacity;
+
+    if (!d_persistent) {
+        d_fallback.resize(capacity);
+        return;
+    }
+
+    release();
+    d_slots.resize(num_slots);
+
+    const auto size = static_cast<GLsizeiptr>(capacity * sizeof(std::uint32_t));
+    for (auto& slot : d_slots) {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, map_flags);
+        slot.texels = static_cast<std::uint32_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, map_flags));
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (std::ranges::any_of(d_slots, [](const slot& s) { return s.texels == nullptr; })) {
+        std::print("could not map the texture upload buffers, texture uploads will not be streamed\n");
+        release();
+        d_persistent = false;
+        d_fallback.resize(capacity);
+    }
+}
+
+auto upload_ring::begin_frame() -> std::span<std::uint32_t>
+{
+    if (!d_persistent) {
+        return d_fallback;
+    }
+
+    auto& slot = d_slots[d_current];
+    if (slot.fence) {
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, fence_timeout_ns);
+        while (status == GL_TIMEOUT_EXPIRED) {
+            status = glClientWaitSync(slot.fence, 0, fence_timeout_ns);
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+    return {slot.texels, d_capacity};
+}
+
+auto upload_ring::upload(texture& target, std::size_t offset, glm::ivec2 top_left, glm::ivec2 size) -> void
+{
+    if (!d_persistent) {
+        target.set_region(top_left, size, d_fallback.data() + offset);
+        return;
+    }
+
+    // With an unpack buffer bound the pointer is an offset into it
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, d_slots[d_current].buffer);
+    target.set_region(top_left, size, reinterpret_cast<const std::uint32_t*>(offset * sizeof(std::uint32_t)));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+auto upload_ring::end_frame() -> void
+{
+    if (!d_persistent) {
+        return;
+    }
+    d_slots[d_current].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    d_current = (d_current + 1) % d_slots.size();
+}
+
+}
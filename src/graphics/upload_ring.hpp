@@ -0,0 +1,55 @@
+#pragma once
+#include "graphics/texture.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace sand {
+
+// Streams texture uploads through a ring of pixel unpack buffers that stay mapped for as
+// long as they exist, so texels are written straight into memory the GPU copies from
+// and the copy happens while the next frame is being prepared. Each frame takes the next
+// buffer in the ring, waiting on a fence only if the GPU is still reading it from that
+// many frames ago.
+//
+// Without ARB_buffer_storage the texels are written to ordinary memory instead and
+// uploaded from there, which behaves the same but lets the driver stall.
+class upload_ring
+{
+    struct slot;
+
+    std::vector<slot>          d_slots;
+    std::size_t                d_current    = 0;
+    std::size_t                d_capacity   = 0; // Texels per frame
+    bool                       d_persistent = false;
+    std::vector<std::uint32_t> d_fallback;
+
+    auto release() -> void;
+
+    upload_ring(const upload_ring&) = delete;
+    upload_ring& operator=(const upload_ring&) = delete;
+
+public:
+    upload_ring();
+    ~upload_ring();
+
+    auto persistent() const -> bool { return d_persistent; }
+
+    // Makes room for at least capacity texels a frame, only between frames
+    auto reserve(std::size_t capacity) -> void;
+
+    // The memory to write this frame's texels to
+    auto begin_frame() -> std::span<std::uint32_t>;
+
+    // Uploads the rectangle from this frame's memory, where its rows are packed one after
+    // another starting offset texels in
+    auto upload(texture& target, std::size_t offset, glm::ivec2 top_left, glm::ivec2 size) -> void;
+
+    // Marks the frame's memory as in use until the GPU has finished the uploads from it
+    auto end_frame() -> void;
+};
+
+}
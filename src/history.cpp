@@ -0,0 +1,104 @@
+#include "history.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace sand {
+
+edit_history::edit_history(std::size_t limit)
+    : d_limit{limit}
+{
+}
+
+auto edit_history::begin() -> void
+{
+    d_open = false;
+    ++d_edit_id;
+}
+
+auto edit_history::save_chunk(const world& pixels, std::size_t index) -> void
+{
+    if (d_copied_in.size() != pixels.get_chunks().size()) {
+        d_copied_in.assign(pixels.get_chunks().size(), 0);
+    }
+    if (!d_open) {
+        // A new edit makes the undone ones unreachable
+        for (; d_undone != 0; --d_undone) {
+            d_bytes -= d_edits.back().bytes;
+            d_edits.pop_back();
+        }
+        d_edits.emplace_back();
+        d_open = true;
+    }
+    if (d_copied_in[index] == d_edit_id) {
+        return;
+    }
+    d_copied_in[index] = d_edit_id;
+
+    const auto source = pixels.chunk_pixels(index);
+    auto& current = d_edits.back();
+    current.chunks.push_back({static_cast<std::uint32_t>(index), {source.begin(), source.end()}});
+    current.bytes += source.size_bytes();
+    d_bytes += source.size_bytes();
+    trim();
+}
+
+auto edit_history::save_region(const world& pixels, glm::ivec2 top_left, glm::ivec2 bottom_right) -> void
+{
+    const auto last = glm::ivec2{pixels.chunks_wide() - 1, pixels.chunks_high() - 1};
+    const auto first_chunk = glm::clamp(top_left / pixels.chunk_size(), glm::ivec2{0, 0}, last);
+    const auto last_chunk = glm::clamp(bottom_right / pixels.chunk_size(), glm::ivec2{0, 0}, last);
+    for (int y = first_chunk.y; y <= last_chunk.y; ++y) {
+        for (int x = first_chunk.x; x <= last_chunk.x; ++x) {
+            save_chunk(pixels, pixels.get_chunk_index({x, y}));
+        }
+    }
+}
+
+auto edit_history::save_all(const world& pixels) -> void
+{
+    for (std::size_t index = 0; index != pixels.get_chunks().size(); ++index) {
+        save_chunk(pixels, index);
+    }
+}
+
+auto edit_history::undo(world& pixels) -> bool
+{
+    if (!can_undo()) return false;
+    begin();
+    ++d_undone;
+    for (auto& copy : d_edits[d_edits.size() - d_undone].chunks) {
+        pixels.exchange_chunk(copy.index, copy.pixels);
+    }
+    return true;
+}
+
+auto edit_history::redo(world& pixels) -> bool
+{
+    if (!can_redo()) return false;
+    begin();
+    for (auto& copy : d_edits[d_edits.size() - d_undone].chunks) {
+        pixels.exchange_chunk(copy.index, copy.pixels);
+    }
+    --d_undone;
+    return true;
+}
+
+auto edit_history::clear() -> void
+{
+    d_edits.clear();
+    d_bytes = 0;
+    d_undone = 0;
+    begin();
+}
+
+// The edit being made is always kept, however big
+auto edit_history::trim() -> void
+{
+    while (d_bytes > d_limit && d_edits.size() > 1) {
+        d_bytes -= d_edits.front().bytes;
+        d_edits.pop_front();
+    }
+}
+
+}
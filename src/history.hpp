@@ -0,0 +1,69 @@
+#pragma once
+#include "world.hpp"
+#include "config.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace sand {
+
+// Undo and redo for edits made to the world. Before an edit first writes to a chunk the
+// chunk is copied into it, so an edit costs only the chunks it touches. Undoing swaps
+// those copies with the world's chunks, which leaves the edit holding what was undone,
+// and redoing swaps them back; both are linear in the chunks the edit touched, however
+// big the world. Only the edited chunks go back: anything that has since moved into or
+// out of them by itself is not tracked.
+//
+// Edits are kept up to a limit on the memory their copies use, past which the oldest
+// are forgotten. Making a new edit forgets the edits that were undone.
+class edit_history
+{
+    struct chunk_copy
+    {
+        std::uint32_t      index;
+        std::vector<pixel> pixels;
+    };
+
+    struct edit
+    {
+        std::vector<chunk_copy> chunks;
+        std::size_t             bytes = 0;
+    };
+
+    std::size_t      d_limit;
+    std::size_t      d_bytes  = 0;
+    std::deque<edit> d_edits;
+    std::size_t      d_undone = 0; // How many edits at the back have been undone
+    bool             d_open   = false;
+
+    // Which edit each chunk was last copied into, so a chunk is copied once per edit
+    std::vector<std::uint64_t> d_copied_in;
+    std::uint64_t              d_edit_id = 1;
+
+    auto trim() -> void;
+
+public:
+    explicit edit_history(std::size_t limit = config::undo_memory_limit);
+
+    // Ends the current edit, writes after this are undone separately
+    auto begin() -> void;
+
+    // Call before writing to a chunk, or to any chunk touching the given pixels
+    auto save_chunk(const world& pixels, std::size_t index) -> void;
+    auto save_region(const world& pixels, glm::ivec2 top_left, glm::ivec2 bottom_right) -> void;
+    auto save_all(const world& pixels) -> void;
+
+    // Return false if there is nothing to undo or redo
+    auto undo(world& pixels) -> bool;
+    auto redo(world& pixels) -> bool;
+
+    auto clear() -> void;
+    auto can_undo() const -> bool { return d_undone != d_edits.size(); }
+    auto can_redo() const -> bool { return d_undone != 0; }
+};
+
+}
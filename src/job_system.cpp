@@ -0,0 +1,210 @@
+#include "job_system.hpp"
+
+#include <cassert>
+#include <memory>
+#include <new>
+
+namespace sand {
+namespace {
+
+// Which job_system, if any, the current thread is a worker of and which queue is its own
+thread_local const void* current_system = nullptr;
+thread_local std::size_t current_queue  = 0;
+
+struct graph_context
+{
+    job_system*               system;
+    task_graph*               graph;
+    std::atomic<std::size_t>* pending;
+};
+
+}
+
+auto scratch_arena::allocate_bytes(std::size_t size, std::size_t align) -> std::byte*
+{
+    while (d_block < d_blocks.size()) {
+        auto& current = d_blocks[d_block];
+        const auto start = (d_offset + align - 1) & ~(align - 1);
+        if (start + size <= current.size) {
+            d_offset = start + size;
+            return current.data.get() + start;
+        }
+        ++d_block;
+        d_offset = 0;
+    }
+
+    // Blocks are aligned for any fundamental type, oversized requests get their own
+    const auto new_size = std::max(size, block_size);
+    d_blocks.push_back({std::make_unique<std::byte[]>(new_size), new_size});
+    d_block = d_blocks.size() - 1;
+    d_offset = size;
+    return d_blocks.back().data.get();
+}
+
+auto task_graph::add(std::function<void()> task) -> task_id
+{
+    auto& n = d_nodes.emplace_back();
+    n.task = std::move(task);
+    return d_nodes.size() - 1;
+}
+
+auto task_graph::precede(task_id before, task_id after) -> void
+{
+    assert(before < d_nodes.size() && after < d_nodes.size());
+    d_nodes[before].successors.push_back(after);
+    ++d_nodes[after].num_predecessors;
+}
+
+job_system::job_system(std::size_t num_workers)
+{
+    for (std::size_t i = 0; i != num_workers + 1; ++i) {
+        d_queues.push_back(std::make_unique<job_queue>());
+    }
+    for (std::size_t i = 0; i != num_workers; ++i) {
+        d_workers.emplace_back([this, queue = i + 1](std::stop_token token) {
+            worker_loop(token, queue);
+        });
+    }
+}
+
+auto job_system::default_num_workers() -> std::size_t
+{
+    const auto threads = std::thread::hardware_concurrency();
+    return threads > 1 ? threads - 1 : 1;
+}
+
+auto job_system::scratch() -> scratch_arena&
+{
+    thread_local scratch_arena arena;
+    return arena;
+}
+
+auto job_system::submit(const job& j) -> void
+{
+    // Counted before it is published so a thief that takes it straight away can't
+    // bring the count below zero
+    d_queued.fetch_add(1);
+    const auto queue = current_system == this ? current_queue : 0;
+    {
+        const auto lock = std::scoped_lock{d_queues[queue]->mutex};
+        d_queues[queue]->jobs.push_back(j);
+    }
+
+    // Taking the park mutex orders this with a worker that is about to sleep, it
+    // either sees the new job or is already waiting and gets woken
+    if (d_sleeping.load() > 0) {
+        { const auto lock = std::scoped_lock{d_park_mutex}; }
+        d_park.notify_one();
+    }
+}
+
+auto job_system::try_pop(std::size_t queue, bool back) -> std::optional<job>
+{
+    auto& q = *d_queues[queue];
+    const auto lock = std::scoped_lock{q.mutex};
+    if (q.jobs.empty()) {
+        return std::nullopt;
+    }
+    auto j = back ? q.jobs.back() : q.jobs.front();
+    if (back) q.jobs.pop_back(); else q.jobs.pop_front();
+    return j;
+}
+
+auto job_system::try_run_one() -> bool
+{
+    // Newest from our own queue first as it is most likely to be in cache, then the
+    // oldest from everyone else, which tends to be the biggest piece of work
+    const auto home = current_system == this ? current_queue : 0;
+    auto j = try_pop(home, true);
+    for (std::size_t i = 1; !j && i != d_queues.size(); ++i) {
+        j = try_pop((home + i) % d_queues.size(), false);
+    }
+    if (!j) {
+        return false;
+    }
+
+    d_queued.fetch_sub(1);
+    j->invoke(j->context, j->index);
+    j->pending->fetch_sub(1, std::memory_order_release);
+
+    // The waiter's counter lives on its stack and may be gone as soon as it reaches zero,
+    // so waiters are woken through one that the job system owns
+    d_completed.fetch_add(1);
+    if (d_waiting.load() > 0) {
+        d_completed.notify_all();
+    }
+    return true;
+}
+
+auto job_system::wait(std::atomic<std::size_t>& pending) -> void
+{
+    while (true) {
+        if (pending.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+        if (try_run_one()) {
+            continue;
+        }
+
+        // Everything left is already running on other threads. Reading the epoch before
+        // checking again means a job finishing in between stops the wait from blocking,
+        // and one that queues more work wakes us to help with it when it finishes.
+        const auto epoch = d_completed.load();
+        if (pending.load(std::memory_order_acquire) == 0 || d_queued.load() > 0) {
+            continue;
+        }
+        ++d_waiting;
+        d_completed.wait(epoch);
+        --d_waiting;
+    }
+}
+
+auto job_system::worker_loop(std::stop_token token, std::size_t queue) -> void
+{
+    current_system = this;
+    current_queue = queue;
+
+    while (!token.stop_requested()) {
+        if (try_run_one()) {
+            continue;
+        }
+
+        auto lock = std::unique_lock{d_park_mutex};
+        ++d_sleeping;
+        d_park.wait(lock, token, [&] { return d_queued.load() > 0; });
+        --d_sleeping;
+    }
+}
+
+// Runs a task then queues up any successors that it was the last dependency of
+auto job_system::invoke_graph_node(const void* context, std::size_t index) -> void
+{
+    const auto& ctx = *static_cast<const graph_context*>(context);
+    auto& n = ctx.graph->d_nodes[index];
+    n.task();
+    for (const auto successor : n.successors) {
+        if (ctx.graph->d_nodes[successor].remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            ctx.system->submit({invoke_graph_node, context, successor, ctx.pending});
+        }
+    }
+}
+
+auto job_system::run(task_graph& graph) -> void
+{
+    if (graph.d_nodes.empty()) return;
+
+    auto pending = std::atomic<std::size_t>{graph.d_nodes.size()};
+    const auto context = graph_context{this, &graph, &pending};
+
+    for (auto& n : graph.d_nodes) {
+        n.remaining.store(n.num_predecessors, std::memory_order_relaxed);
+    }
+    for (std::size_t index = 0; index != graph.d_nodes.size(); ++index) {
+        if (graph.d_nodes[index].num_predecessors == 0) {
+            submit({invoke_graph_node, &context, index, &pending});
+        }
+    }
+    wait(pending);
+}
+
+}
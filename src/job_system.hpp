@@ -0,0 +1,200 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace sand {
+
+// Bump allocator for short lived scratch memory. Each thread has its own, see
+// job_system::scratch. Memory is handed out from a list of blocks that are kept
+// between uses, so after warming up it never touches the heap. Only for trivially
+// destructible types, nothing is destroyed when the memory is released.
+class scratch_arena
+{
+    static constexpr std::size_t block_size = 1 << 20;
+
+    struct block
+    {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t                  size;
+    };
+
+    std::vector<block> d_blocks;
+    std::size_t        d_block  = 0;
+    std::size_t        d_offset = 0;
+
+    auto allocate_bytes(std::size_t size, std::size_t align) -> std::byte*;
+
+public:
+    struct marker
+    {
+        std::size_t block;
+        std::size_t offset;
+    };
+
+    template <typename T>
+    auto allocate(std::size_t count) -> std::span<T>
+    {
+        static_assert(std::is_trivially_destructible_v<T>);
+        auto data = allocate_bytes(count * sizeof(T), alignof(T));
+        return {std::launder(reinterpret_cast<T*>(data)), count};
+    }
+
+    auto mark() const -> marker { return {d_block, d_offset}; }
+    auto release(marker m) -> void { d_block = m.block; d_offset = m.offset; }
+};
+
+// Releases everything allocated from the arena during its lifetime
+class scratch_scope
+{
+    scratch_arena&        d_arena;
+    scratch_arena::marker d_marker;
+
+    scratch_scope(const scratch_scope&) = delete;
+    scratch_scope& operator=(const scratch_scope&) = delete;
+
+public:
+    explicit scratch_scope(scratch_arena& arena) : d_arena{arena}, d_marker{arena.mark()} {}
+    ~scratch_scope() { d_arena.release(d_marker); }
+};
+
+// A set of tasks with dependencies between them, run with job_system::run. A graph
+// can be run any number of times but must not be changed while it is running.
+class task_graph
+{
+public:
+    using task_id = std::size_t;
+
+    auto add(std::function<void()> task) -> task_id;
+
+    // The after task will not start until the before task has finished
+    auto precede(task_id before, task_id after) -> void;
+
+    auto size() const -> std::size_t { return d_nodes.size(); }
+
+private:
+    friend class job_system;
+
+    struct node
+    {
+        std::function<void()>    task;
+        std::vector<task_id>     successors;
+        std::size_t              num_predecessors = 0;
+        std::atomic<std::size_t> remaining        = 0;
+    };
+
+    std::deque<node> d_nodes;
+};
+
+// A fixed pool of worker threads shared by the whole application. Each worker has
+// its own queue that it pushes to and pops from at the back, and when that is empty
+// it steals from the front of the other queues. Threads outside the pool submit to a
+// shared queue. Workers with nothing to do park on a condition variable.
+//
+// Waiting for work to finish never blocks while there is work queued; the waiting
+// thread runs jobs itself, so calls can nest and be made from any thread.
+class job_system
+{
+    struct job
+    {
+        void (*invoke)(const void* context, std::size_t index);
+        const void*               context;
+        std::size_t               index;
+        std::atomic<std::size_t>* pending;
+    };
+
+    struct job_queue
+    {
+        std::mutex      mutex;
+        std::deque<job> jobs;
+    };
+
+    // Queue 0 is the shared queue for threads outside the pool, then one per worker
+    std::vector<std::unique_ptr<job_queue>> d_queues;
+
+    std::mutex                  d_park_mutex;
+    std::condition_variable_any d_park;
+    std::atomic<std::size_t>    d_queued   = 0;
+    std::atomic<std::size_t>    d_sleeping = 0;
+
+    // Bumped whenever a job finishes, threads waiting on jobs running elsewhere park on it
+    std::atomic<std::uint32_t>  d_completed = 0;
+    std::atomic<std::size_t>    d_waiting   = 0;
+
+    // Declared last so the workers are stopped before the queues are destroyed
+    std::vector<std::jthread> d_workers;
+
+    auto submit(const job& j) -> void;
+    auto try_pop(std::size_t queue, bool back) -> std::optional<job>;
+    auto try_run_one() -> bool;
+    auto wait(std::atomic<std::size_t>& pending) -> void;
+    auto worker_loop(std::stop_token token, std::size_t queue) -> void;
+
+    static auto invoke_graph_node(const void* context, std::size_t index) -> void;
+
+    job_system(const job_system&) = delete;
+    job_system& operator=(const job_system&) = delete;
+
+public:
+    // Defaults to one worker per hardware thread other than the one creating it
+    explicit job_system(std::size_t num_workers = default_num_workers());
+
+    static auto default_num_workers() -> std::size_t;
+
+    auto num_workers() const -> std::size_t { return d_workers.size(); }
+
+    // Calls func(begin, end) for consecutive ranges of at most grain indices
+    // covering [0, count) and returns when they have all finished. The first range
+    // runs on the calling thread.
+    template <typename Func>
+    auto parallel_for(std::size_t count, std::size_t grain, Func&& func) -> void;
+
+    // Runs every task in the graph respecting its dependencies, returns when all
+    // have finished
+    auto run(task_graph& graph) -> void;
+
+    // The scratch arena for the calling thread
+    static auto scratch() -> scratch_arena&;
+};
+
+template <typename Func>
+auto job_system::parallel_for(std::size_t count, std::size_t grain, Func&& func) -> void
+{
+    if (count == 0) return;
+    grain = std::max<std::size_t>(grain, 1);
+    const auto num_ranges = (count + grain - 1) / grain;
+
+    struct range_context
+    {
+        std::remove_reference_t<Func>* func;
+        std::size_t                    count;
+        std::size_t                    grain;
+    };
+
+    const auto context = range_context{&func, count, grain};
+    const auto invoke = [](const void* ptr, std::size_t index) {
+        const auto& ctx = *static_cast<const range_context*>(ptr);
+        const auto begin = index * ctx.grain;
+        (*ctx.func)(begin, std::min(ctx.count, begin + ctx.grain));
+    };
+
+    auto pending = std::atomic<std::size_t>{num_ranges - 1};
+    for (std::size_t index = 1; index < num_ranges; ++index) {
+        submit({invoke, &context, index, &pending});
+    }
+    invoke(&context, 0);
+    wait(pending);
+}
+
+}
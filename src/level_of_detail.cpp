@@ -0,0 +1,49 @@
+#include "level_of_detail.hpp"
+#include "config.hpp"
+
+#include <algorithm>
+
+namespace sand {
+namespace {
+
+// Number of chunks between a chunk and a rectangle of chunks, 0 if they overlap
+auto chunk_distance(glm::ivec2 chunk, glm::ivec2 min, glm::ivec2 max) -> int
+{
+    const auto dx = std::max({min.x - chunk.x, chunk.x - max.x, 0});
+    const auto dy = std::max({min.y - chunk.y, chunk.y - max.y, 0});
+    return std::max(dx, dy);
+}
+
+auto period_for_distance(int distance) -> int
+{
+    if (distance == 0) return 1;
+    if (distance <= sand::config::lod_half_rate_distance) return 2;
+    if (distance <= sand::config::lod_quarter_rate_distance) return 4;
+    return 0;
+}
+
+}
+
+template <typename Geometry>
+auto schedule_chunks(basic_world<Geometry>& pixels, const viewport& view, glm::vec2 player) -> void
+{
+    const auto chunk_size = static_cast<float>(pixels.chunk_size());
+    const auto view_min = glm::ivec2{glm::floor(view.top_left / chunk_size)};
+    const auto view_max = glm::ivec2{glm::floor((view.top_left + view.size) / chunk_size)};
+    const auto player_chunk = glm::ivec2{glm::floor(player / chunk_size)};
+
+    const auto num_chunks = pixels.get_chunks().size();
+    for (std::size_t index = 0; index != num_chunks; ++index) {
+        const auto chunk = pixels.get_chunk_pos(index);
+        const auto distance = std::min(
+            chunk_distance(chunk, view_min, view_max),
+            chunk_distance(chunk, player_chunk - 1, player_chunk + 1)
+        );
+        pixels.set_update_period(index, period_for_distance(distance));
+    }
+}
+
+template auto schedule_chunks(basic_world<sand::config::geometry>&, const viewport&, glm::vec2) -> void;
+template auto schedule_chunks(basic_world<dynamic_geometry>&, const viewport&, glm::vec2) -> void;
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "world.hpp"
+
+#include <glm/glm.hpp>
+
+namespace sand {
+
+// The area of the world being looked at, in pixel space
+struct viewport
+{
+    glm::vec2 top_left;
+    glm::vec2 size;
+};
+
+// Sets the update period of every chunk by its distance, in chunks, from the nearer
+// of the viewport and the chunks around the player. See config for the distances used.
+template <typename Geometry>
+auto schedule_chunks(basic_world<Geometry>& pixels, const viewport& view, glm::vec2 player) -> void;
+
+}
@@ -0,0 +1,138 @@
+#include "lz.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace sand {
+namespace {
+
+static constexpr std::size_t min_match  = 4;
+static constexpr std::size_t max_offset = 65535;
+static constexpr int         hash_bits  = 12;
+
+auto read32(const std::uint8_t* p) -> std::uint32_t
+{
+    auto value = std::uint32_t{0};
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+auto hash(std::uint32_t value) -> std::size_t
+{
+    return (value * 2654435761u) >> (32 - hash_bits);
+}
+
+// Lengths that don't fit in the token's four bits continue in bytes of 255
+auto write_length(std::vector<std::uint8_t>& out, std::size_t length) -> void
+{
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(static_cast<std::uint8_t>(length));
+}
+
+auto read_length(std::span<const std::uint8_t> in, std::size_t& pos, std::size_t& length) -> bool
+{
+    while (true) {
+        if (pos == in.size()) return false;
+        const auto byte = in[pos++];
+        length += byte;
+        if (byte != 255) return true;
+    }
+}
+
+auto write_sequence(
+    std::vector<std::uint8_t>& out,
+    std::span<const std::uint8_t> literals,
+    std::size_t offset,
+    std::size_t match_length
+) -> void
+{
+    const auto lit = literals.size();
+    const auto match = match_length == 0 ? 0 : match_length - min_match;
+    out.push_back(static_cast<std::uint8_t>((std::min<std::size_t>(lit, 15) << 4) | std::min<std::size_t>(match, 15)));
+    if (lit >= 15) write_length(out, lit - 15);
+    out.insert(out.end(), literals.begin(), literals.end());
+
+    // The final sequence is only literals
+    if (match_length == 0) return;
+    out.push_back(static_cast<std::uint8_t>(offset & 0xff));
+    out.push_back(static_cast<std::uint8_t>(offset >> 8));
+    if (match >= 15) write_length(out, match - 15);
+}
+
+}
+
+auto lz_compress(std::span<const std::uint8_t> in) -> std::vector<std::uint8_t>
+{
+    auto out = std::vector<std::uint8_t>{};
+    out.reserve(in.size() / 2 + 16);
+
+    // Most recent position + 1 of each hashed four bytes, 0 meaning none yet
+    auto table = std::array<std::uint32_t, 1 << hash_bits>{};
+
+    std::size_t anchor = 0;
+    std::size_t pos = 0;
+    while (pos + min_match <= in.size()) {
+        const auto value = read32(in.data() + pos);
+        auto& entry = table[hash(value)];
+        const auto candidate = static_cast<std::size_t>(entry);
+        entry = static_cast<std::uint32_t>(pos + 1);
+
+        if (candidate == 0 || pos - (candidate - 1) > max_offset || read32(in.data() + candidate - 1) != value) {
+            ++pos;
+            continue;
+        }
+
+        const auto match_start = candidate - 1;
+        auto length = min_match;
+        while (pos + length < in.size() && in[match_start + length] == in[pos + length]) {
+            ++length;
+        }
+
+        write_sequence(out, in.subspan(anchor, pos - anchor), pos - match_start, length);
+        pos += length;
+        anchor = pos;
+    }
+
+    write_sequence(out, in.subspan(anchor), 0, 0);
+    return out;
+}
+
+auto lz_decompress(std::span<const std::uint8_t> in, std::span<std::uint8_t> out) -> bool
+{
+    std::size_t ip = 0;
+    std::size_t op = 0;
+    while (ip != in.size()) {
+        const auto token = in[ip++];
+
+        auto lit = static_cast<std::size_t>(token >> 4);
+        if (lit == 15 && !read_length(in, ip, lit)) return false;
+        if (lit > in.size() - ip || lit > out.size() - op) return false;
+        std::memcpy(out.data() + op, in.data() + ip, lit);
+        ip += lit;
+        op += lit;
+
+        if (ip == in.size()) break;
+
+        if (in.size() - ip < 2) return false;
+        const auto offset = static_cast<std::size_t>(in[ip]) | (static_cast<std::size_t>(in[ip + 1]) << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) return false;
+
+        auto match = static_cast<std::size_t>(token & 0x0f);
+        if (match == 15 && !read_length(in, ip, match)) return false;
+        match += min_match;
+        if (match > out.size() - op) return false;
+
+        // Byte by byte as the match may overlap what it is writing
+        for (std::size_t i = 0; i != match; ++i, ++op) {
+            out[op] = out[op - offset];
+        }
+    }
+    return op == out.size();
+}
+
+}
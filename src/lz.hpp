@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace sand {
+
+// A small LZ77 codec using the LZ4 block layout: runs of literals followed by a
+// back reference of at least four bytes up to 64KiB back. Fast in both directions,
+// which matters more here than squeezing out the last few bytes.
+auto lz_compress(std::span<const std::uint8_t> in) -> std::vector<std::uint8_t>;
+
+// Decompresses into out, which must be exactly the size of the original data. Returns
+// false if the input is malformed or doesn't fill out exactly.
+auto lz_decompress(std::span<const std::uint8_t> in, std::span<std::uint8_t> out) -> bool;
+
+}
@@ -0,0 +1,205 @@
+#include "mapped_file.hpp"
+
+#include <print>
+#include <utility>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sand {
+
+mapped_file::mapped_file(mapped_file&& other) noexcept
+    : d_file{std::exchange(other.d_file, no_file)}
+#ifdef _WIN32
+    , d_mapping{std::exchange(other.d_mapping, nullptr)}
+#endif
+    , d_data{std::exchange(other.d_data, nullptr)}
+    , d_size{std::exchange(other.d_size, 0)}
+{
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        d_file = std::exchange(other.d_file, no_file);
+#ifdef _WIN32
+        d_mapping = std::exchange(other.d_mapping, nullptr);
+#endif
+        d_data = std::exchange(other.d_data, nullptr);
+        d_size = std::exchange(other.d_size, 0);
+    }
+    return *this;
+}
+
+mapped_file::~mapped_file()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+auto mapped_file::close() -> void
+{
+    if (d_data) UnmapViewOfFile(d_data);
+    if (d_mapping) CloseHandle(d_mapping);
+    if (d_file != no_file && d_file != INVALID_HANDLE_VALUE) CloseHandle(d_file);
+    d_file = no_file;
+    d_mapping = nullptr;
+    d_data = nullptr;
+    d_size = 0;
+}
+
+namespace {
+
+auto map_handle(void*& mapping, std::byte*& data, void* handle, std::size_t size, map_access access) -> bool
+{
+    const auto protect = access == map_access::read_write ? PAGE_READWRITE : PAGE_READONLY;
+    mapping = CreateFileMappingA(
+        handle, nullptr, protect,
+        static_cast<DWORD>(static_cast<std::uint64_t>(size) >> 32), static_cast<DWORD>(size & 0xffffffff),
+        nullptr
+    );
+    if (!mapping) return false;
+    const auto view_access = access == map_access::read_write ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ;
+    data = static_cast<std::byte*>(MapViewOfFile(mapping, view_access, 0, 0, size));
+    return data != nullptr;
+}
+
+}
+
+auto mapped_file::create(const std::string& filename, std::size_t size) -> std::optional<mapped_file>
+{
+    auto file = mapped_file{};
+    file.d_file = CreateFileA(
+        filename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr
+    );
+    if (file.d_file == INVALID_HANDLE_VALUE) {
+        std::print("could not create {}\n", filename);
+        return std::nullopt;
+    }
+    if (!map_handle(file.d_mapping, file.d_data, file.d_file, size, map_access::read_write)) {
+        std::print("could not map {}\n", filename);
+        return std::nullopt;
+    }
+    file.d_size = size;
+    return file;
+}
+
+auto mapped_file::open(const std::string& filename, map_access access) -> std::optional<mapped_file>
+{
+    auto file = mapped_file{};
+    const auto desired = access == map_access::read_write ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+    file.d_file = CreateFileA(
+        filename.c_str(), desired, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+    );
+    if (file.d_file == INVALID_HANDLE_VALUE) {
+        std::print("could not open {}\n", filename);
+        return std::nullopt;
+    }
+    auto size = LARGE_INTEGER{};
+    if (!GetFileSizeEx(file.d_file, &size) || size.QuadPart == 0) {
+        std::print("{} is empty\n", filename);
+        return std::nullopt;
+    }
+    if (!map_handle(file.d_mapping, file.d_data, file.d_file, static_cast<std::size_t>(size.QuadPart), access)) {
+        std::print("could not map {}\n", filename);
+        return std::nullopt;
+    }
+    file.d_size = static_cast<std::size_t>(size.QuadPart);
+    return file;
+}
+
+auto mapped_file::flush(std::size_t offset, std::size_t length) const -> bool
+{
+    return FlushViewOfFile(d_data + offset, length);
+}
+
+auto mapped_file::commit() const -> bool
+{
+    return FlushFileBuffers(d_file);
+}
+
+#else
+
+auto mapped_file::close() -> void
+{
+    if (d_data) munmap(d_data, d_size);
+    if (d_file != no_file) ::close(d_file);
+    d_file = no_file;
+    d_data = nullptr;
+    d_size = 0;
+}
+
+auto mapped_file::create(const std::string& filename, std::size_t size) -> std::optional<mapped_file>
+{
+    auto file = mapped_file{};
+    file.d_file = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file.d_file == -1) {
+        std::print("could not create {}\n", filename);
+        return std::nullopt;
+    }
+    if (ftruncate(file.d_file, static_cast<off_t>(size)) != 0) {
+        std::print("could not resize {}\n", filename);
+        return std::nullopt;
+    }
+    auto data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file.d_file, 0);
+    if (data == MAP_FAILED) {
+        std::print("could not map {}\n", filename);
+        return std::nullopt;
+    }
+    file.d_data = static_cast<std::byte*>(data);
+    file.d_size = size;
+    return file;
+}
+
+auto mapped_file::open(const std::string& filename, map_access access) -> std::optional<mapped_file>
+{
+    auto file = mapped_file{};
+    file.d_file = ::open(filename.c_str(), access == map_access::read_write ? O_RDWR : O_RDONLY);
+    if (file.d_file == -1) {
+        std::print("could not open {}\n", filename);
+        return std::nullopt;
+    }
+    struct stat info = {};
+    if (fstat(file.d_file, &info) != 0 || info.st_size == 0) {
+        std::print("{} is empty\n", filename);
+        return std::nullopt;
+    }
+    const auto size = static_cast<std::size_t>(info.st_size);
+    const auto protect = access == map_access::read_write ? PROT_READ | PROT_WRITE : PROT_READ;
+    auto data = mmap(nullptr, size, protect, MAP_SHARED, file.d_file, 0);
+    if (data == MAP_FAILED) {
+        std::print("could not map {}\n", filename);
+        return std::nullopt;
+    }
+    file.d_data = static_cast<std::byte*>(data);
+    file.d_size = size;
+    return file;
+}
+
+auto mapped_file::flush(std::size_t offset, std::size_t length) const -> bool
+{
+    // msync needs a page aligned start
+    const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    const auto start = offset / page * page;
+    return msync(d_data + start, length + (offset - start), MS_ASYNC) == 0;
+}
+
+auto mapped_file::commit() const -> bool
+{
+    // The page cache is shared with the mapping, so this also writes the mapped pages
+    return fsync(d_file) == 0;
+}
+
+#endif
+
+}
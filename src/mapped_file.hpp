@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <string>
+
+namespace sand {
+
+enum class map_access
+{
+    read_only,
+    read_write,
+};
+
+// A whole file mapped into memory. Writes through a read-write mapping go to the file,
+// the OS pages it in and out as it is touched, flush starts writing a range out and
+// commit makes sure everything flushed is on disk.
+// Uses the Windows file mapping API, or mmap elsewhere.
+class mapped_file
+{
+#ifdef _WIN32
+    using handle = void*;
+    static constexpr handle no_file = nullptr;
+#else
+    using handle = int;
+    static constexpr handle no_file = -1;
+#endif
+
+    handle d_file = no_file;
+#ifdef _WIN32
+    handle d_mapping = nullptr;
+#endif
+    std::byte*  d_data = nullptr;
+    std::size_t d_size = 0;
+
+    auto close() -> void;
+
+    mapped_file() = default;
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+public:
+    mapped_file(mapped_file&& other) noexcept;
+    mapped_file& operator=(mapped_file&& other) noexcept;
+    ~mapped_file();
+
+    // Creates the file, replacing any existing one, with the given size and maps it
+    // read-write. The contents start zeroed.
+    static auto create(const std::string& filename, std::size_t size) -> std::optional<mapped_file>;
+
+    // Maps an existing file in full
+    static auto open(const std::string& filename, map_access access) -> std::optional<mapped_file>;
+
+    auto data() const -> std::byte* { return d_data; }
+    auto size() const -> std::size_t { return d_size; }
+
+    // Starts writing the given byte range to disk, without waiting for it to get there
+    auto flush(std::size_t offset, std::size_t length) const -> bool;
+
+    // Blocks until everything flushed so far is on disk. Syncing the file is expensive,
+    // so flush every range first and commit once.
+    auto commit() const -> bool;
+};
+
+}
@@ -59,4 +59,15 @@ auto keyboard::is_down_this_frame(keyboard_key key) const -> bool
     return d_down_this_frame.test(std::to_underlying(key));
 }
 
+auto keyboard::get_state() const -> keyboard_state
+{
+    return {d_down, d_down_this_frame};
+}
+
+auto keyboard::set_state(const keyboard_state& state) -> void
+{
+    d_down = state.down;
+    d_down_this_frame = state.down_this_frame;
+}
+
 }
\ No newline at end of file
@@ -32,6 +32,18 @@ enum class keyboard_key
     Q = 81,
     S = 83,
     W = 87,
+    Y = 89,
+    Z = 90,
+};
+
+// Bits of the mods of a keyboard event, the same as GLFW's
+static constexpr int modifier_control = 0x0002;
+
+// Which keys are held and which were pressed since the last frame
+struct keyboard_state
+{
+    std::bitset<128> down;
+    std::bitset<128> down_this_frame;
 };
 
 class keyboard
@@ -45,6 +57,9 @@ public:
 
     auto is_down(keyboard_key key) const -> bool;
     auto is_down_this_frame(keyboard_key key) const -> bool;
+
+    auto get_state() const -> keyboard_state;
+    auto set_state(const keyboard_state& state) -> void;
 };
     
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include "pixel.hpp"
 #include "utility.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <cstdlib>
 #include <print>
 #include <vector>
@@ -8,6 +11,22 @@
 namespace sand {
 namespace {
 
+constexpr auto property_table = [] {
+    auto table = std::array<pixel_properties, num_pixel_types>{};
+    for (std::size_t i = 0; i != num_pixel_types; ++i) {
+        table[i] = properties(static_cast<pixel_type>(i));
+    }
+    return table;
+}();
+
+constexpr auto chance_table = [] {
+    auto table = std::array<pixel_chances, num_pixel_types>{};
+    for (std::size_t i = 0; i != num_pixel_types; ++i) {
+        table[i] = chances(static_cast<pixel_type>(i));
+    }
+    return table;
+}();
+
 auto light_noise() -> glm::vec4
 {
     return {
@@ -18,423 +37,354 @@ auto light_noise() -> glm::vec4
     };
 }
 
+// Pixels keep the shade of their colour so the renderer doesn't work it out per texel
+auto shaded(pixel px) -> pixel
+{
+    px.shade = to_shade(px);
+    return px;
+}
+
+// The colour the factories make pixels of this type with
+auto made_colour(pixel_type type) -> glm::vec4
+{
+    const auto base = base_colour(type);
+    return property_table[static_cast<std::size_t>(type)].light_noise ? base + light_noise() : base;
+}
+
 }
 
 auto properties(const pixel& pix) -> const pixel_properties&
 {
-    switch (pix.type) {
-        case pixel_type::none: {
-            static constexpr auto px = pixel_properties{
-                .phase = pixel_phase::gas,
-                .corrosion_resist = 1.0f
-            };
-            return px;
-        }
-        case pixel_type::sand: {
-            static constexpr auto px = pixel_properties{
-                .can_move_diagonally = true,
-                .gravity_factor = 1.0f,
-                .inertial_resistance = 0.1f,
-                .corrosion_resist = 0.3f
-            };
-            return px;
-        }
-        case pixel_type::dirt: {
-            static constexpr auto px = pixel_properties{
-                .can_move_diagonally = true,
-                .gravity_factor = 1.0f,
-                .inertial_resistance = 0.4f,
-                .corrosion_resist = 0.5f
-            };
-            return px;
-        }
-        case pixel_type::coal: {
-            static constexpr auto px = pixel_properties{
-                .can_move_diagonally = true,
-                .gravity_factor = 1.0f,
-                .inertial_resistance = 0.95f,
-                .corrosion_resist = 0.8f,
-                .flammability = 0.02f,
-                .put_out_surrounded = 0.15f,
-                .put_out = 0.02f,
-                .burn_out_chance = 0.005f
-            };
-            return px;
-        }
-        case pixel_type::water: {
-            static constexpr auto px = pixel_properties{
-                .phase = pixel_phase::liquid,
-                .can_move_diagonally = true,
-                .gravity_factor = 1.0f,
-                .dispersion_rate = 5,
-                .corrosion_resist = 1.0f,
-            };
-            return px;
-        }
-        case pixel_type::lava: {
-            static constexpr auto px = pixel_properties{
-                .phase = pixel_phase::liquid,
-                .can_move_diagonally = true,
-                .gravity_factor = 1.0f,
-                .dispersion_rate = 1,
-                .can_boil_water = true,
-                .corrosion_resist = 1.0f,
-                .is_burn_source = true,
-                .is_ember_source = true
-            };
-            return px;
-        }
-        case pixel_type::acid: {
-            static constexpr auto px = pixel_properties{
-                .phase = pixel_phase::liquid,
-                .can_move_diagonally = true,
-                .gravity_factor = 1.0f,
-                .dispersion_rate = 1,
-                .corrosion_resist = 1.0f,
-                .is_corrosion_source = true
-            };
-            return px;
-        }
-        case pixel_type::rock: {
-            static constexpr auto px = pixel_properties{
-                .corrosion_resist = 0.95f,
-            };
-            return px;
-        }
-        case pixel_type::titanium: {
-            static constexpr auto px = pixel_properties{
-                .corrosion_resist = 1.0f,
-                .power_type = pixel_power_type::conductor,
-                .power_max = 25
-            };
-            return px;
-        }
-        case pixel_type::steam: {
-            static constexpr auto px = pixel_properties{
-                .phase = pixel_phase::gas,
-                .can_move_diagonally = true,
-                .gravity_factor = -1.0f,
-                .dispersion_rate = 9,
-                .corrosion_resist = 0.0f
-            };
-            return px;
-        }
-        case pixel_type::fuse: {
-            static constexpr auto px = pixel_properties{
-                .corrosion_resist = 0.1f,
-                .flammability = 0.25f,
-                .put_out_surrounded = 0.0f,
-                .put_out = 0.0f,
-                .burn_out_chance = 0.1f
-            };
-            return px;
-        }
-        case pixel_type::ember: {
-            static constexpr auto px = pixel_properties{
-                .phase = pixel_phase::gas,
-                .can_move_diagonally = true,
-                .gravity_factor = -1.0f,
-                .always_awake = true,
-                .corrosion_resist = 0.1f,
-                .flammability = 1.0f,
-                .put_out_surrounded = 0.0f,
-                .put_out = 0.0f,
-                .burn_out_chance = 0.2f
-            };
-            return px;
-        }
-        case pixel_type::oil: {
-            static constexpr auto px = pixel_properties{
-                .phase = pixel_phase::liquid,
-                .can_move_diagonally = true,
-                .gravity_factor = 1.0f,
-                .dispersion_rate = 2,
-                .corrosion_resist = 0.1f,
-                .flammability = 0.05f,
-                .put_out_surrounded = 0.3f,
-                .put_out = 0.02f,
-                .burn_out_chance = 0.005f
-            };
-            return px;
-        }
-        case pixel_type::gunpowder: {
-            static constexpr auto px = pixel_properties{
-                .can_move_diagonally = true,
-                .gravity_factor = 1.0f,
-                .inertial_resistance = 0.1f,
-                .corrosion_resist = 0.1f,
-                .flammability = 0.25f,
-                .put_out_surrounded = 0.0f,
-                .put_out = 0.0f,
-                .burn_out_chance = 0.1f,
-                .explosion_chance = 0.001f
-            };
-            return px;
-        }
-        case pixel_type::methane: {
-            static constexpr auto px = pixel_properties{
-                .phase = pixel_phase::gas,
-                .can_move_diagonally = true,
-                .gravity_factor = -1.0f,
-                .dispersion_rate = 4,
-                .corrosion_resist = 0.0f,
-                .flammability = 0.25f,
-                .put_out_surrounded = 0.0f,
-                .put_out = 0.0f,
-                .burn_out_chance = 0.1f
-            };
-            return px;
-        }
-        case pixel_type::battery: {
-            static constexpr auto px = pixel_properties{
-                .always_awake = true,
-                .corrosion_resist = 1.0f,
-                .power_type = pixel_power_type::source,
-                .power_max = 5
-            };
-            return px;
-        }
-        case pixel_type::solder: {
-            static constexpr auto px = pixel_properties{
-                .can_move_diagonally = true,
-                .gravity_factor = 1.0f,
-                .inertial_resistance = 0.05f,
-                .corrosion_resist = 1.0f,
-                .power_type = pixel_power_type::conductor,
-                .power_max = 24
-            };
-            return px;
-        }
-        case pixel_type::diode_in:
-        case pixel_type::diode_out: {
-            static constexpr auto px = pixel_properties{
-                .corrosion_resist = 1.0f,
-                .power_type = pixel_power_type::conductor,
-                .power_max = 25
-            };
-            return px;
-        }
-        case pixel_type::spark: {
-            static constexpr auto px = pixel_properties{
-                .always_awake = true,
-                .spontaneous_destroy = 0.3f,
-                .corrosion_resist = 0.1f,
-                .power_type = pixel_power_type::source,
-                .power_max = 100
-            };
-            return px;
-        }
-        case pixel_type::c4: {
-            static constexpr auto px = pixel_properties{
-                .corrosion_resist = 0.95f,
-                .explodes_on_power = true,
-                .power_type = pixel_power_type::conductor,
-                .power_max = 10
-            };
-            return px;
-        }
-        case pixel_type::relay: {
-            static constexpr auto px = pixel_properties{
-                .corrosion_resist = 1.0f
-            };
-            return px;
-        }
+    const auto index = static_cast<std::size_t>(pix.type);
+    if (index >= num_pixel_types) {
+        std::print("ERROR: Unknown pixel type {}\n", index);
+        static constexpr auto px = pixel_properties{};
+        return px;
+    }
+    return property_table[index];
+}
+
+auto chances(const pixel& pix) -> const pixel_chances&
+{
+    const auto index = static_cast<std::size_t>(pix.type);
+    if (index >= num_pixel_types) {
+        std::print("ERROR: Unknown pixel type {}\n", index);
+        static constexpr auto px = pixel_chances{};
+        return px;
+    }
+    return chance_table[index];
+}
+
+auto to_string(pixel_type type) -> std::string_view
+{
+    switch (type) {
+        case pixel_type::none:      return "air";
+        case pixel_type::sand:      return "sand";
+        case pixel_type::dirt:      return "dirt";
+        case pixel_type::coal:      return "coal";
+        case pixel_type::water:     return "water";
+        case pixel_type::lava:      return "lava";
+        case pixel_type::acid:      return "acid";
+        case pixel_type::rock:      return "rock";
+        case pixel_type::titanium:  return "titanium";
+        case pixel_type::steam:     return "steam";
+        case pixel_type::fuse:      return "fuse";
+        case pixel_type::ember:     return "ember";
+        case pixel_type::oil:       return "oil";
+        case pixel_type::gunpowder: return "gunpowder";
+        case pixel_type::methane:   return "methane";
+        case pixel_type::battery:   return "battery";
+        case pixel_type::solder:    return "solder";
+        case pixel_type::diode_in:  return "diode_in";
+        case pixel_type::diode_out: return "diode_out";
+        case pixel_type::spark:     return "spark";
+        case pixel_type::c4:        return "c4";
+        case pixel_type::relay:     return "relay";
+        default:                    return "unknown";
+    }
+}
+
+auto base_colour(pixel_type type) -> glm::vec4
+{
+    switch (type) {
+        case pixel_type::none:      return from_hex(0x2C3A47);
+        case pixel_type::sand:      return from_hex(0xF8EFBA);
+        case pixel_type::coal:      return from_hex(0x1E272E);
+        case pixel_type::dirt:      return from_hex(0x5C1D06);
+        case pixel_type::rock:      return from_hex(0xC8C8C8);
+        case pixel_type::water:     return from_hex(0x1B9CFC);
+        case pixel_type::lava:      return from_hex(0xF97F51);
+        case pixel_type::acid:      return from_hex(0x2ED573);
+        case pixel_type::steam:     return from_hex(0x9AECDB);
+        case pixel_type::titanium:  return from_hex(0xDFE4EA);
+        case pixel_type::fuse:      return from_hex(0x45AAF2);
+        case pixel_type::ember:     return from_hex(0xFFFFFF);
+        case pixel_type::oil:       return from_hex(0x650C30);
+        case pixel_type::gunpowder: return from_hex(0x485460);
+        case pixel_type::methane:   return from_hex(0xCED6E0);
+        case pixel_type::battery:   return from_hex(0xF0932B);
+        case pixel_type::solder:    return from_hex(0xB2BEC3);
+        case pixel_type::diode_in:  return from_hex(0x22A6B3);
+        case pixel_type::diode_out: return from_hex(0xBE2EDD);
+        case pixel_type::spark:     return from_hex(0xE1B12C);
+        case pixel_type::c4:        return from_hex(0xB8E994);
+        case pixel_type::relay:     return from_hex(0x192A56);
+        default:                    return from_hex(0x000000);
+    }
+}
+
+auto to_shade(const pixel& px) -> std::uint8_t
+{
+    const auto base = glm::vec3{base_colour(px.type)};
+    const auto base_length = glm::dot(base, base);
+    if (base_length == 0.0f) return 128;
+    const auto shade = 128.0f * glm::dot(glm::vec3{px.colour}, base) / base_length;
+    return static_cast<std::uint8_t>(std::clamp(std::round(shade), 0.0f, 255.0f));
+}
+
+auto from_shade(pixel_type type, std::uint8_t shade) -> glm::vec4
+{
+    return glm::vec4{glm::vec3{base_colour(type)} * (shade / 128.0f), 1.0f};
+}
+
+auto make_pixel(pixel_type type) -> pixel
+{
+    switch (type) {
+        case pixel_type::none:      return pixel::air();
+        case pixel_type::sand:      return pixel::sand();
+        case pixel_type::dirt:      return pixel::dirt();
+        case pixel_type::coal:      return pixel::coal();
+        case pixel_type::water:     return pixel::water();
+        case pixel_type::lava:      return pixel::lava();
+        case pixel_type::acid:      return pixel::acid();
+        case pixel_type::rock:      return pixel::rock();
+        case pixel_type::titanium:  return pixel::titanium();
+        case pixel_type::steam:     return pixel::steam();
+        case pixel_type::fuse:      return pixel::fuse();
+        case pixel_type::ember:     return pixel::ember();
+        case pixel_type::oil:       return pixel::oil();
+        case pixel_type::gunpowder: return pixel::gunpowder();
+        case pixel_type::methane:   return pixel::methane();
+        case pixel_type::battery:   return pixel::battery();
+        case pixel_type::solder:    return pixel::solder();
+        case pixel_type::diode_in:  return pixel::diode_in();
+        case pixel_type::diode_out: return pixel::diode_out();
+        case pixel_type::spark:     return pixel::spark();
+        case pixel_type::c4:        return pixel::c4();
+        case pixel_type::relay:     return pixel::relay();
         default: {
-            std::print("ERROR: Unknown pixel type {}\n", static_cast<int>(pix.type));
-            static constexpr auto px = pixel_properties{};
-            return px;
+            std::print("ERROR: Unknown pixel type {}\n", static_cast<int>(type));
+            return pixel::air();
         }
     }
 }
 
+auto make_pixels(pixel_type type, std::span<pixel> out) -> void
+{
+    const auto prototype = make_pixel(type);
+    std::ranges::fill(out, prototype);
+    if (!property_table[static_cast<std::size_t>(type)].light_noise) return;
+
+    // Ten bits of the word per channel, spread over the same range as light_noise
+    const auto base = base_colour(type);
+    const auto channel = [](std::uint32_t bits) {
+        return static_cast<float>(bits & 0x3ff) * (0.08f / 1023.0f) - 0.04f;
+    };
+    for (auto& px : out) {
+        const auto word = random_word();
+        px.colour = base + glm::vec4{channel(word), channel(word >> 10), channel(word >> 20), 1.0f};
+        px.shade = to_shade(px);
+    }
+}
+
 auto pixel::air() -> pixel
 {
-    return pixel{
+    return shaded({
         .type = pixel_type::none,
-        .colour = from_hex(0x2C3A47)
-    };
+        .colour = made_colour(pixel_type::none)
+    });
 }
 
 auto pixel::sand() -> pixel
 {
     auto p = pixel{
         .type = pixel_type::sand,
-        .colour = from_hex(0xF8EFBA) + light_noise()
+        .colour = made_colour(pixel_type::sand)
     };
     p.flags[is_falling] = true;
-    return p;
+    return shaded(p);
 }
 
 auto pixel::coal() -> pixel
 {
     auto p = pixel{
         .type = pixel_type::coal,
-        .colour = from_hex(0x1E272E) + light_noise()
+        .colour = made_colour(pixel_type::coal)
     };
     p.flags[is_falling] = true;
-    return p;
+    return shaded(p);
 }
 
 auto pixel::dirt() -> pixel
 {
     auto p = pixel{
         .type = pixel_type::dirt,
-        .colour = from_hex(0x5C1D06) + light_noise()
+        .colour = made_colour(pixel_type::dirt)
     };
     p.flags[is_falling] = true;
-    return p;
+    return shaded(p);
 }
 
 auto pixel::rock() -> pixel
 {
-    return {
+    return shaded({
         .type = pixel_type::rock,
-        .colour = from_hex(0xC8C8C8) + light_noise()
-    };
+        .colour = made_colour(pixel_type::rock)
+    });
 }
 
 auto pixel::water() -> pixel
 {
-    return {
+    return shaded({
         .type = pixel_type::water,
-        .colour = from_hex(0x1B9CFC) + light_noise()
-    };
+        .colour = made_colour(pixel_type::water)
+    });
 }
 
 auto pixel::lava() -> pixel
 {
-    return {
+    return shaded({
         .type = pixel_type::lava,
-        .colour = from_hex(0xF97F51) + light_noise()
-    };
+        .colour = made_colour(pixel_type::lava)
+    });
 }
 
 auto pixel::acid() -> pixel
 {
-    return {
+    return shaded({
         .type = pixel_type::acid,
-        .colour = from_hex(0x2ED573) + light_noise()
-    };
+        .colour = made_colour(pixel_type::acid)
+    });
 }
 
 auto pixel::steam() -> pixel
 {
-    return {
+    return shaded({
         .type = pixel_type::steam,
-        .colour = from_hex(0x9AECDB) + light_noise()
-    };
+        .colour = made_colour(pixel_type::steam)
+    });
 }
 
 auto pixel::titanium() -> pixel
 {
-    return {
+    return shaded({
         .type = pixel_type::titanium,
-        .colour = from_hex(0xDFE4EA)
-    };
+        .colour = made_colour(pixel_type::titanium)
+    });
 }
 
 auto pixel::fuse() -> pixel
 {
-    return {
+    return shaded({
         .type = pixel_type::fuse,
-        .colour = from_hex(0x45AAF2) + light_noise()
-    };
+        .colour = made_colour(pixel_type::fuse)
+    });
 }
 
 auto pixel::ember() -> pixel
 {
     auto p = pixel{
         .type = pixel_type::ember,
-        .colour = from_hex(0xFFFFFF)
+        .colour = made_colour(pixel_type::ember)
     };
     p.flags[is_burning] = true;
-    return p;
+    return shaded(p);
 }
 
 auto pixel::oil() -> pixel
 {
-    return {
+    return shaded({
         .type = pixel_type::oil,
-        .colour = from_hex(0x650C30) + light_noise()
-    };
+        .colour = made_colour(pixel_type::oil)
+    });
 }
 
 auto pixel::gunpowder() -> pixel
 {
     auto p = pixel{
         .type = pixel_type::gunpowder,
-        .colour = from_hex(0x485460) + light_noise()
+        .colour = made_colour(pixel_type::gunpowder)
     };
     p.flags[is_falling] = true;
-    return p;
+    return shaded(p);
 }
 
 auto pixel::methane() -> pixel
 {
-    return {
+    return shaded({
         .type = pixel_type::methane,
-        .colour = from_hex(0xCED6E0) + light_noise()
-    };
+        .colour = made_colour(pixel_type::methane)
+    });
 }
 
 auto pixel::battery() -> pixel
 {
-    return {
+    return shaded({
         .type = pixel_type::battery,
-        .colour = from_hex(0xF0932B)
-    };
+        .colour = made_colour(pixel_type::battery)
+    });
 }
 
 auto pixel::solder() -> pixel
 {
     auto p = pixel{
         .type = pixel_type::solder,
-        .colour = from_hex(0xB2BEC3)
+        .colour = made_colour(pixel_type::solder)
     };
     p.flags[is_falling] = true;
-    return p;
+    return shaded(p);
 }
 
 auto pixel::diode_in() -> pixel
 {
-    return {
+    return shaded({
         .type = pixel_type::diode_in,
-        .colour = from_hex(0x22A6B3)
-    };
+        .colour = made_colour(pixel_type::diode_in)
+    });
 }
 
 auto pixel::diode_out() -> pixel
 {
-    return {
+    return shaded({
         .type = pixel_type::diode_out,
-        .colour = from_hex(0xBE2EDD)
-    };
+        .colour = made_colour(pixel_type::diode_out)
+    });
 }
 
 auto pixel::spark() -> pixel
 {
     auto p = pixel{
         .type = pixel_type::spark,
-        .colour = from_hex(0xE1B12C)
+        .colour = made_colour(pixel_type::spark)
     };
     p.power = properties(p).power_max;
-    return p;
+    return shaded(p);
 }
 
 auto pixel::c4() -> pixel
 {
-    return {
+    return shaded({
         .type = pixel_type::c4,
-        .colour = from_hex(0xB8E994)
-    };
+        .colour = made_colour(pixel_type::c4)
+    });
 }
 
 auto pixel::relay() -> pixel
 {
-    return {
+    return shaded({
         .type = pixel_type::relay,
-        .colour = from_hex(0x192A56)
-    };
+        .colour = made_colour(pixel_type::relay)
+    });
 }
 
 auto is_active_power_source(const pixel& px) -> bool
@@ -1,8 +1,12 @@
 #pragma once
+#include "utility.hpp"
+
 #include <glm/glm.hpp>
 
 #include <bitset>
 #include <cstdint>
+#include <span>
+#include <string_view>
 
 namespace sand {
 
@@ -53,6 +57,19 @@ enum class pixel_type : std::uint8_t
     relay
 };
 
+static constexpr auto num_pixel_types = static_cast<std::size_t>(pixel_type::relay) + 1;
+
+// A set of pixel types, one bit per type
+using pixel_type_mask = std::uint32_t;
+static_assert(num_pixel_types <= 32);
+
+constexpr auto type_bit(pixel_type type) -> pixel_type_mask
+{
+    return pixel_type_mask{1} << static_cast<std::size_t>(type);
+}
+
+auto to_string(pixel_type type) -> std::string_view;
+
 struct pixel_properties
 {
     // Movement Controls
@@ -88,8 +105,239 @@ struct pixel_properties
     // Electricity Controls
     pixel_power_type power_type     = pixel_power_type::none;
     std::uint8_t     power_max      = 0; // The maximum power this pixel can accept
+
+    // Appearance
+    bool        light_noise         = false; // Is the base colour varied per pixel?
 };
 
+// Available at compile time so that the update kernels can be specialised per material
+constexpr auto properties(pixel_type type) -> pixel_properties
+{
+    switch (type) {
+        case pixel_type::none: {
+            return pixel_properties{
+                .phase = pixel_phase::gas,
+                .corrosion_resist = 1.0f
+            };
+        }
+        case pixel_type::sand: {
+            return pixel_properties{
+                .can_move_diagonally = true,
+                .gravity_factor = 1.0f,
+                .inertial_resistance = 0.1f,
+                .corrosion_resist = 0.3f,
+                .light_noise = true
+            };
+        }
+        case pixel_type::dirt: {
+            return pixel_properties{
+                .can_move_diagonally = true,
+                .gravity_factor = 1.0f,
+                .inertial_resistance = 0.4f,
+                .corrosion_resist = 0.5f,
+                .light_noise = true
+            };
+        }
+        case pixel_type::coal: {
+            return pixel_properties{
+                .can_move_diagonally = true,
+                .gravity_factor = 1.0f,
+                .inertial_resistance = 0.95f,
+                .corrosion_resist = 0.8f,
+                .flammability = 0.02f,
+                .put_out_surrounded = 0.15f,
+                .put_out = 0.02f,
+                .burn_out_chance = 0.005f,
+                .light_noise = true
+            };
+        }
+        case pixel_type::water: {
+            return pixel_properties{
+                .phase = pixel_phase::liquid,
+                .can_move_diagonally = true,
+                .gravity_factor = 1.0f,
+                .dispersion_rate = 5,
+                .corrosion_resist = 1.0f,
+                .light_noise = true
+            };
+        }
+        case pixel_type::lava: {
+            return pixel_properties{
+                .phase = pixel_phase::liquid,
+                .can_move_diagonally = true,
+                .gravity_factor = 1.0f,
+                .dispersion_rate = 1,
+                .can_boil_water = true,
+                .corrosion_resist = 1.0f,
+                .is_burn_source = true,
+                .is_ember_source = true,
+                .light_noise = true
+            };
+        }
+        case pixel_type::acid: {
+            return pixel_properties{
+                .phase = pixel_phase::liquid,
+                .can_move_diagonally = true,
+                .gravity_factor = 1.0f,
+                .dispersion_rate = 1,
+                .corrosion_resist = 1.0f,
+                .is_corrosion_source = true,
+                .light_noise = true
+            };
+        }
+        case pixel_type::rock: {
+            return pixel_properties{
+                .corrosion_resist = 0.95f,
+                .light_noise = true
+            };
+        }
+        case pixel_type::titanium: {
+            return pixel_properties{
+                .corrosion_resist = 1.0f,
+                .power_type = pixel_power_type::conductor,
+                .power_max = 25
+            };
+        }
+        case pixel_type::steam: {
+            return pixel_properties{
+                .phase = pixel_phase::gas,
+                .can_move_diagonally = true,
+                .gravity_factor = -1.0f,
+                .dispersion_rate = 9,
+                .corrosion_resist = 0.0f,
+                .light_noise = true
+            };
+        }
+        case pixel_type::fuse: {
+            return pixel_properties{
+                .corrosion_resist = 0.1f,
+                .flammability = 0.25f,
+                .put_out_surrounded = 0.0f,
+                .put_out = 0.0f,
+                .burn_out_chance = 0.1f,
+                .light_noise = true
+            };
+        }
+        case pixel_type::ember: {
+            return pixel_properties{
+                .phase = pixel_phase::gas,
+                .can_move_diagonally = true,
+                .gravity_factor = -1.0f,
+                .always_awake = true,
+                .corrosion_resist = 0.1f,
+                .flammability = 1.0f,
+                .put_out_surrounded = 0.0f,
+                .put_out = 0.0f,
+                .burn_out_chance = 0.2f
+            };
+        }
+        case pixel_type::oil: {
+            return pixel_properties{
+                .phase = pixel_phase::liquid,
+                .can_move_diagonally = true,
+                .gravity_factor = 1.0f,
+                .dispersion_rate = 2,
+                .corrosion_resist = 0.1f,
+                .flammability = 0.05f,
+                .put_out_surrounded = 0.3f,
+                .put_out = 0.02f,
+                .burn_out_chance = 0.005f,
+                .light_noise = true
+            };
+        }
+        case pixel_type::gunpowder: {
+            return pixel_properties{
+                .can_move_diagonally = true,
+                .gravity_factor = 1.0f,
+                .inertial_resistance = 0.1f,
+                .corrosion_resist = 0.1f,
+                .flammability = 0.25f,
+                .put_out_surrounded = 0.0f,
+                .put_out = 0.0f,
+                .burn_out_chance = 0.1f,
+                .explosion_chance = 0.001f,
+                .light_noise = true
+            };
+        }
+        case pixel_type::methane: {
+            return pixel_properties{
+                .phase = pixel_phase::gas,
+                .can_move_diagonally = true,
+                .gravity_factor = -1.0f,
+                .dispersion_rate = 4,
+                .corrosion_resist = 0.0f,
+                .flammability = 0.25f,
+                .put_out_surrounded = 0.0f,
+                .put_out = 0.0f,
+                .burn_out_chance = 0.1f,
+                .light_noise = true
+            };
+        }
+        case pixel_type::battery: {
+            return pixel_properties{
+                .always_awake = true,
+                .corrosion_resist = 1.0f,
+                .power_type = pixel_power_type::source,
+                .power_max = 5
+            };
+        }
+        case pixel_type::solder: {
+            return pixel_properties{
+                .can_move_diagonally = true,
+                .gravity_factor = 1.0f,
+                .inertial_resistance = 0.05f,
+                .corrosion_resist = 1.0f,
+                .power_type = pixel_power_type::conductor,
+                .power_max = 24
+            };
+        }
+        case pixel_type::diode_in:
+        case pixel_type::diode_out: {
+            return pixel_properties{
+                .corrosion_resist = 1.0f,
+                .power_type = pixel_power_type::conductor,
+                .power_max = 25
+            };
+        }
+        case pixel_type::spark: {
+            return pixel_properties{
+                .always_awake = true,
+                .spontaneous_destroy = 0.3f,
+                .corrosion_resist = 0.1f,
+                .power_type = pixel_power_type::source,
+                .power_max = 100
+            };
+        }
+        case pixel_type::c4: {
+            return pixel_properties{
+                .corrosion_resist = 0.95f,
+                .explodes_on_power = true,
+                .power_type = pixel_power_type::conductor,
+                .power_max = 10
+            };
+        }
+        case pixel_type::relay: {
+            return pixel_properties{
+                .corrosion_resist = 1.0f
+            };
+        }
+        default: {
+            return pixel_properties{};
+        }
+    }
+}
+
+// Returns the set of types for which pred(type) is true
+constexpr auto make_type_mask(auto&& pred) -> pixel_type_mask
+{
+    auto mask = pixel_type_mask{0};
+    for (std::size_t i = 0; i != num_pixel_types; ++i) {
+        const auto type = static_cast<pixel_type>(i);
+        if (pred(type)) mask |= type_bit(type);
+    }
+    return mask;
+}
+
 struct pixel
 {
     pixel_type      type;
@@ -101,6 +349,10 @@ struct pixel
     // For power sources, it is a value between in [0, 5), with 5 being active
     std::uint8_t    power = 0;
 
+    // The colour as a brightness of the type's base colour, see to_shade. Kept in step
+    // with the colour by everything that sets it, so the renderer can copy it as is
+    std::uint8_t    shade = 128;
+
     static auto air() -> pixel;
     static auto sand() -> pixel;
     static auto coal() -> pixel;
@@ -125,6 +377,52 @@ struct pixel
     static auto relay() -> pixel;
 };
 
+// The probabilities from pixel_properties that are rolled against at runtime,
+// converted to integer thresholds when the material table is built
+struct pixel_chances
+{
+    probability start_falling;      // 1 - inertial_resistance
+    probability ignite;             // flammability
+    probability put_out;            // put_out
+    probability put_out_surrounded; // put_out_surrounded
+    probability burn_out;           // burn_out_chance
+    probability explode;            // explosion_chance
+    probability destroy;            // spontaneous_destroy
+};
+
+constexpr auto chances(pixel_type type) -> pixel_chances
+{
+    const auto props = properties(type);
+    return {
+        .start_falling      = probability{1.0f - props.inertial_resistance},
+        .ignite             = probability{props.flammability},
+        .put_out            = probability{props.put_out},
+        .put_out_surrounded = probability{props.put_out_surrounded},
+        .burn_out           = probability{props.burn_out_chance},
+        .explode            = probability{props.explosion_chance},
+        .destroy            = probability{props.spontaneous_destroy}
+    };
+}
+
+auto chances(const pixel& px) -> const pixel_chances&;
+
+// Creates a new pixel of the given type, equivalent to calling the matching factory
+auto make_pixel(pixel_type type) -> pixel;
+
+// Fills out with new pixels of the given type, the same as calling make_pixel for each
+// but drawing the colour noise for a pixel from a single random word
+auto make_pixels(pixel_type type, std::span<pixel> out) -> void;
+
+// The colour pixels of this type are made with, before any noise is added
+auto base_colour(pixel_type type) -> glm::vec4;
+
+// Colours are the type's base colour scaled by a brightness, with 128 meaning unscaled.
+// The noise each pixel was made with survives as a brightness but not as a hue. Pixels
+// carry their shade, to_shade works it out again after the colour is changed.
+auto to_shade(const pixel& px) -> std::uint8_t;
+auto from_shade(pixel_type type, std::uint8_t shade) -> glm::vec4;
+
+// Runtime lookup into a table built from the constexpr overload above
 auto properties(const pixel& px) -> const pixel_properties&;
 
 auto serialise(auto& archive, pixel& px) -> void {
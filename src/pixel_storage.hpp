@@ -0,0 +1,82 @@
+#pragma once
+#include "pixel.hpp"
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sand {
+
+// The memory a world keeps its pixels in: either its own heap allocation or a region
+// of a mapped file, in which case writes to the pixels are writes to the file. Copies
+// are always on the heap.
+class pixel_storage
+{
+    static_assert(std::is_trivially_copyable_v<pixel>);
+
+    std::vector<pixel>         d_heap;
+    std::optional<mapped_file> d_file;
+    std::span<pixel>           d_pixels;
+
+public:
+    pixel_storage() = default;
+
+    explicit pixel_storage(std::size_t count)
+        : d_heap(count)
+        , d_pixels{d_heap}
+    {}
+
+    // The pixels start offset bytes into the file, which must be suitably aligned
+    pixel_storage(mapped_file file, std::size_t offset, std::size_t count)
+        : d_file{std::move(file)}
+    {
+        assert(offset % alignof(pixel) == 0);
+        assert(offset + count * sizeof(pixel) <= d_file->size());
+        d_pixels = {reinterpret_cast<pixel*>(d_file->data() + offset), count};
+    }
+
+    pixel_storage(const pixel_storage& other)
+        : d_heap(other.d_pixels.begin(), other.d_pixels.end())
+        , d_pixels{d_heap}
+    {}
+
+    pixel_storage& operator=(const pixel_storage& other)
+    {
+        if (this != &other) {
+            *this = pixel_storage{other};
+        }
+        return *this;
+    }
+
+    // Moving a vector or a mapping keeps the memory where it is, so the span stays valid
+    pixel_storage(pixel_storage&& other) noexcept
+        : d_heap{std::move(other.d_heap)}
+        , d_file{std::move(other.d_file)}
+        , d_pixels{std::exchange(other.d_pixels, {})}
+    {}
+
+    pixel_storage& operator=(pixel_storage&& other) noexcept
+    {
+        if (this != &other) {
+            d_heap = std::move(other.d_heap);
+            d_file = std::move(other.d_file);
+            d_pixels = std::exchange(other.d_pixels, {});
+        }
+        return *this;
+    }
+
+    auto pixels() const -> std::span<pixel> { return d_pixels; }
+    auto size() const -> std::size_t { return d_pixels.size(); }
+    auto operator[](std::size_t index) const -> pixel& { return d_pixels[index]; }
+
+    // The file the pixels live in, if any
+    auto file() const -> const mapped_file* { return d_file ? &*d_file : nullptr; }
+};
+
+}
@@ -8,6 +8,14 @@
 
 namespace sand {
 
+// Everything about the player that changes as it moves, in physics units
+struct player_state
+{
+    glm::vec2 position;
+    glm::vec2 velocity;
+    bool      double_jump;
+};
+
 class player_controller {
     int      d_width;
     int      d_height;
@@ -88,6 +96,19 @@ public:
         }
     }
 
+    auto get_state() const -> player_state {
+        const auto& pos = d_body->GetPosition();
+        const auto& vel = d_body->GetLinearVelocity();
+        return {{pos.x, pos.y}, {vel.x, vel.y}, d_double_jump};
+    }
+
+    void set_state(const player_state& state) {
+        d_body->SetTransform({state.position.x, state.position.y}, d_body->GetAngle());
+        d_body->SetLinearVelocity({state.velocity.x, state.velocity.y});
+        d_body->SetAwake(true);
+        d_double_jump = state.double_jump;
+    }
+
     auto get_body() const -> const b2Body* {
         return d_body;
     }
@@ -0,0 +1,99 @@
+#pragma once
+#include "pixel.hpp"
+
+#include <array>
+#include <cstdint>
+
+namespace sand {
+
+enum class reaction_action : std::uint8_t
+{
+    none,
+    convert, // The neighbour is replaced with the result type
+    corrode, // The neighbour is destroyed, with a chance of consuming the source too
+    ignite,  // The neighbour starts burning
+    emit,    // An empty neighbour is filled with the result type
+};
+
+struct reaction
+{
+    reaction_action action         = reaction_action::none;
+    float           chance         = 0.0f; // Chance per tick per neighbour that it happens
+    pixel_type      result         = pixel_type::none;
+    float           consume_chance = 0.0f; // Chance the source becomes air when it happens
+};
+
+struct reaction_table
+{
+    // Indexed by [source][neighbour]
+    std::array<std::array<reaction, num_pixel_types>, num_pixel_types> by_type;
+
+    // How a burning pixel of any type affects its neighbours, used when the source
+    // has no reaction of its own with that neighbour. Indexed by [neighbour]
+    std::array<reaction, num_pixel_types> burning;
+
+    // False for materials that never affect their neighbours unless burning
+    std::array<bool, num_pixel_types> has_reactions;
+};
+
+constexpr auto make_reaction_table() -> reaction_table
+{
+    auto table = reaction_table{};
+
+    const auto ignite = [](pixel_type dst) {
+        const auto flammability = properties(dst).flammability;
+        if (flammability == 0.0f) return reaction{};
+        return reaction{ .action = reaction_action::ignite, .chance = flammability };
+    };
+
+    const auto emit_ember = [](pixel_type dst) {
+        if (dst != pixel_type::none) return reaction{};
+        return reaction{
+            .action = reaction_action::emit, .chance = 0.01f, .result = pixel_type::ember
+        };
+    };
+
+    for (std::size_t d = 0; d != num_pixel_types; ++d) {
+        const auto dst = static_cast<pixel_type>(d);
+        table.burning[d] = ignite(dst);
+        if (table.burning[d].action == reaction_action::none) {
+            table.burning[d] = emit_ember(dst);
+        }
+    }
+
+    for (std::size_t s = 0; s != num_pixel_types; ++s) {
+        const auto src = properties(static_cast<pixel_type>(s));
+        for (std::size_t d = 0; d != num_pixel_types; ++d) {
+            const auto dst = static_cast<pixel_type>(d);
+            auto& r = table.by_type[s][d];
+
+            // Rules are in priority order, the first that applies wins
+            if (src.can_boil_water && dst == pixel_type::water) {
+                r = { .action = reaction_action::convert, .chance = 1.0f, .result = pixel_type::steam };
+            }
+            else if (src.is_corrosion_source && properties(dst).corrosion_resist < 1.0f) {
+                r = {
+                    .action = reaction_action::corrode,
+                    .chance = 1.0f - properties(dst).corrosion_resist,
+                    .consume_chance = 0.1f
+                };
+            }
+            else if (src.is_burn_source && ignite(dst).action != reaction_action::none) {
+                r = ignite(dst);
+            }
+            else if (src.is_ember_source && emit_ember(dst).action != reaction_action::none) {
+                r = emit_ember(dst);
+            }
+
+            if (r.action != reaction_action::none) {
+                table.has_reactions[s] = true;
+            }
+        }
+    }
+
+    return table;
+}
+
+inline constexpr auto reactions = make_reaction_table();
+
+}
@@ -0,0 +1,484 @@
+#include "recording.hpp"
+#include "save.hpp"
+#include "binary_io.hpp"
+#include "utility.hpp"
+
+#include <bit>
+#include <bitset>
+#include <chrono>
+#include <print>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace sand {
+namespace {
+
+static constexpr std::uint32_t session_magic = four_cc("SREC");
+// Version 2 widened the number of commands in a tick to 32 bits, version 3 added the
+// held keys
+static constexpr std::uint32_t session_version = 3;
+
+// The finaliser from splitmix64, every input bit affects every output bit
+auto mix(std::uint64_t x) -> std::uint64_t
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+auto combine(std::uint64_t seed, std::uint64_t value) -> std::uint64_t
+{
+    return mix(seed ^ (value + 0x9e3779b97f4a7c15ull));
+}
+
+// Commands are stored as their index in the variant followed by their fields
+template <typename T, typename Variant>
+struct variant_index;
+
+template <typename T, typename... Types>
+struct variant_index<T, std::variant<Types...>>
+{
+    static constexpr auto value = [] {
+        auto index = std::uint8_t{0};
+        ((std::is_same_v<T, Types> ? false : (++index, true)) && ...);
+        return index;
+    }();
+};
+
+template <typename T>
+constexpr auto tag = variant_index<T, command>::value;
+
+// Only the fields are hashed, never the bytes of a pixel, as those include padding
+auto hash_chunk(std::span<const pixel> pixels) -> std::uint64_t
+{
+    auto hash = std::uint64_t{0};
+    for (const auto& px : pixels) {
+        hash = combine(hash, static_cast<std::uint64_t>(px.type) | (std::uint64_t{px.power} << 8));
+        hash = combine(hash, std::bit_cast<std::uint32_t>(px.colour.x) | (std::uint64_t{std::bit_cast<std::uint32_t>(px.colour.y)} << 32));
+        hash = combine(hash, std::bit_cast<std::uint32_t>(px.colour.z) | (std::uint64_t{std::bit_cast<std::uint32_t>(px.colour.w)} << 32));
+        hash = combine(hash, std::bit_cast<std::uint32_t>(px.velocity.x) | (std::uint64_t{std::bit_cast<std::uint32_t>(px.velocity.y)} << 32));
+        hash = combine(hash, px.flags.to_ullong());
+    }
+    return hash;
+}
+
+auto write_player(std::ostream& out, const player_state& player) -> void
+{
+    write(out, player.position);
+    write(out, player.velocity);
+    write(out, static_cast<std::uint8_t>(player.double_jump));
+}
+
+// Key sets are written a byte at a time as the layout of a bitset is up to the library
+auto write_keys(std::ostream& out, const std::bitset<128>& keys) -> void
+{
+    for (std::size_t i = 0; i != keys.size(); i += 8) {
+        auto byte = std::uint8_t{0};
+        for (std::size_t bit = 0; bit != 8; ++bit) {
+            byte |= static_cast<std::uint8_t>(keys[i + bit]) << bit;
+        }
+        write(out, byte);
+    }
+}
+
+// Reads values from a session file, failures are sticky so they only need checking
+// once a whole record has been read
+class session_reader
+{
+    std::istream& d_in;
+    bool          d_ok = true;
+
+public:
+    explicit session_reader(std::istream& in) : d_in{in} {}
+
+    auto ok() const -> bool { return d_ok; }
+    auto at_end() -> bool { return d_ok && d_in.peek() == std::char_traits<char>::eof(); }
+
+    template <typename T>
+    auto read() -> T
+    {
+        auto value = T{};
+        d_ok = d_ok && sand::read(d_in, value);
+        return value;
+    }
+
+    auto read_type() -> pixel_type
+    {
+        const auto type = read<std::uint8_t>();
+        if (type >= num_pixel_types) d_ok = false;
+        return static_cast<pixel_type>(type);
+    }
+
+    auto read_player() -> player_state
+    {
+        auto player = player_state{};
+        player.position = read<glm::vec2>();
+        player.velocity = read<glm::vec2>();
+        player.double_jump = read<std::uint8_t>() != 0;
+        return player;
+    }
+
+    auto read_keys() -> std::bitset<128>
+    {
+        auto keys = std::bitset<128>{};
+        for (std::size_t i = 0; i != keys.size(); i += 8) {
+            const auto byte = read<std::uint8_t>();
+            for (std::size_t bit = 0; bit != 8; ++bit) {
+                keys[i + bit] = (byte >> bit) & 1;
+            }
+        }
+        return keys;
+    }
+
+    auto read_bytes(std::size_t count) -> std::string
+    {
+        auto bytes = std::string(count, '\0');
+        if (d_ok) {
+            d_in.read(bytes.data(), static_cast<std::streamsize>(count));
+            d_ok = static_cast<std::size_t>(d_in.gcount()) == count;
+        }
+        return bytes;
+    }
+
+    // Sizes are checked against the stamp before anything is allocated for them
+    auto read_plane_size(glm::ivec2 size) -> std::size_t
+    {
+        const auto plane_size = read<std::uint32_t>();
+        if (!valid_stamp_size(size) || plane_size > max_plane_size(size)) {
+            d_ok = false;
+            return 0;
+        }
+        return plane_size;
+    }
+
+    auto read_command() -> std::optional<command>
+    {
+        switch (read<std::uint8_t>()) {
+            case tag<spray_command>: {
+                const auto centre = read<glm::ivec2>();
+                const auto radius = read<float>();
+                return spray_command{centre, radius, read_type()};
+            }
+            case tag<square_command>: {
+                const auto centre = read<glm::ivec2>();
+                const auto half_extent = read<std::int32_t>();
+                return square_command{centre, half_extent, read_type()};
+            }
+            case tag<circle_command>: {
+                const auto centre = read<glm::ivec2>();
+                const auto radius = read<float>();
+                return circle_command{centre, radius, read_type()};
+            }
+            case tag<flood_fill_command>: {
+                const auto centre = read<glm::ivec2>();
+                return flood_fill_command{centre, read_type()};
+            }
+            case tag<replace_command>: {
+                const auto centre = read<glm::ivec2>();
+                const auto half_extent = read<std::int32_t>();
+                return replace_command{centre, half_extent, read_type()};
+            }
+            case tag<explosion_command>: {
+                const auto centre = read<glm::ivec2>();
+                return explosion_command{centre, read<explosion>()};
+            }
+            case tag<clear_command>: {
+                return clear_command{};
+            }
+            case tag<key_command>: {
+                const auto key = read<std::int32_t>();
+                return key_command{key, read<std::uint8_t>() != 0};
+            }
+            case tag<begin_edit_command>: {
+                return begin_edit_command{};
+            }
+            case tag<undo_command>: {
+                return undo_command{};
+            }
+            case tag<redo_command>: {
+                return redo_command{};
+            }
+            case tag<view_command>: {
+                return view_command{read<viewport>()};
+            }
+            case tag<paste_command>: {
+                const auto top_left = read<glm::ivec2>();
+                auto stamp = std::make_shared<region_stamp>();
+                stamp->size = read<glm::ivec2>();
+                const auto types = read_bytes(read_plane_size(stamp->size));
+                stamp->types.assign(types.begin(), types.end());
+                const auto shades = read_bytes(read_plane_size(stamp->size));
+                stamp->shades.assign(shades.begin(), shades.end());
+                return paste_command{top_left, std::move(stamp)};
+            }
+            default: {
+                d_ok = false;
+                return std::nullopt;
+            }
+        }
+    }
+};
+
+}
+
+auto world_hasher::hash(const world& pixels, job_system& jobs) -> std::uint64_t
+{
+    const auto& chunks = pixels.get_chunks();
+    if (d_chunk_hashes.size() != chunks.size()) {
+        d_chunk_hashes.assign(chunks.size(), 0);
+        d_next_tick = 0;
+    }
+
+    jobs.parallel_for(chunks.size(), chunks_per_encode_job, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t index = begin; index != end; ++index) {
+            if (chunks[index].modified_tick >= d_next_tick) {
+                d_chunk_hashes[index] = hash_chunk(pixels.chunk_pixels(index));
+            }
+        }
+    });
+    d_next_tick = pixels.tick();
+
+    auto hash = std::uint64_t{0};
+    for (const auto chunk_hash : d_chunk_hashes) {
+        hash = combine(hash, chunk_hash);
+    }
+    return hash;
+}
+
+auto session_recorder::create(
+    const std::string& filename,
+    world& pixels,
+    const player_state& player,
+    const keyboard_state& keys,
+    const viewport& view,
+    std::uint64_t seed,
+    job_system& jobs
+) -> std::unique_ptr<session_recorder>
+{
+    auto recorder = std::unique_ptr<session_recorder>{new session_recorder{}};
+    recorder->d_file.open(filename, std::ios::binary);
+    if (!recorder->d_file) {
+        std::print("could not record to {}\n", filename);
+        return nullptr;
+    }
+
+    auto initial = std::ostringstream{};
+    if (!save_world(pixels, initial, jobs)) {
+        return nullptr;
+    }
+    auto save = std::move(initial).str();
+
+    // Saves keep a shade rather than the exact colour, so the world is swapped for its
+    // saved form to start from exactly what a replay loads
+    auto saved = std::make_unique<world>();
+    auto in = std::istringstream{save};
+    if (!load_world(*saved, in, filename, jobs)) {
+        return nullptr;
+    }
+    pixels.replace(std::move(*saved));
+    pixels.set_tick(pixels.tick());
+
+    auto& out = recorder->d_file;
+    write(out, session_magic);
+    write(out, session_version);
+    write(out, seed);
+    write(out, pixels.tick());
+    write_player(out, player);
+    write_keys(out, keys.down);
+    write_keys(out, keys.down_this_frame);
+    write(out, view);
+    write(out, static_cast<std::uint64_t>(save.size()));
+    out.write(save.data(), static_cast<std::streamsize>(save.size()));
+
+    // Everything after this is rehashed only as it changes
+    recorder->d_hasher.hash(pixels, jobs);
+    std::print("recording to {}\n", filename);
+    return recorder;
+}
+
+auto session_recorder::record(const command& cmd) -> bool
+{
+    auto& out = d_tick_commands;
+    const auto begin = [&]<typename T>(const T&) {
+        write(out, tag<T>);
+        ++d_num_commands;
+    };
+    return std::visit(overloaded{
+        [&](const spray_command& c) {
+            begin(c);
+            write(out, c.centre);
+            write(out, c.radius);
+            write(out, static_cast<std::uint8_t>(c.type));
+            return true;
+        },
+        [&](const square_command& c) {
+            begin(c);
+            write(out, c.centre);
+            write(out, static_cast<std::int32_t>(c.half_extent));
+            write(out, static_cast<std::uint8_t>(c.type));
+            return true;
+        },
+        [&](const circle_command& c) {
+            begin(c);
+            write(out, c.centre);
+            write(out, c.radius);
+            write(out, static_cast<std::uint8_t>(c.type));
+            return true;
+        },
+        [&](const flood_fill_command& c) {
+            begin(c);
+            write(out, c.centre);
+            write(out, static_cast<std::uint8_t>(c.type));
+            return true;
+        },
+        [&](const replace_command& c) {
+            begin(c);
+            write(out, c.centre);
+            write(out, static_cast<std::int32_t>(c.half_extent));
+            write(out, static_cast<std::uint8_t>(c.type));
+            return true;
+        },
+        [&](const paste_command& c) {
+            begin(c);
+            write(out, c.top_left);
+            write(out, c.stamp->size);
+            write(out, static_cast<std::uint32_t>(c.stamp->types.size()));
+            write_bytes(out, c.stamp->types);
+            write(out, static_cast<std::uint32_t>(c.stamp->shades.size()));
+            write_bytes(out, c.stamp->shades);
+            return true;
+        },
+        [&](const explosion_command& c) {
+            begin(c);
+            write(out, c.centre);
+            write(out, c.info);
+            return true;
+        },
+        [&](const clear_command& c) {
+            begin(c);
+            return true;
+        },
+        [&](const key_command& c) {
+            begin(c);
+            write(out, static_cast<std::int32_t>(c.key));
+            write(out, static_cast<std::uint8_t>(c.pressed));
+            return true;
+        },
+        [&](const view_command& c) {
+            begin(c);
+            write(out, c.view);
+            return true;
+        },
+        [&](const begin_edit_command& c) {
+            begin(c);
+            return true;
+        },
+        [&](const undo_command& c) {
+            begin(c);
+            return true;
+        },
+        [&](const redo_command& c) {
+            begin(c);
+            return true;
+        },
+        [&](const replace_world_command&) { return false; },
+        [&](const map_world_command&) { return false; },
+        // The budget is ignored while recording, the rest don't change the simulation
+        [&](const auto&) { return true; }
+    }, cmd);
+}
+
+auto session_recorder::end_tick(const world& pixels, job_system& jobs) -> void
+{
+    const auto commands = std::move(d_tick_commands).str();
+    write(d_file, d_num_commands);
+    d_file.write(commands.data(), static_cast<std::streamsize>(commands.size()));
+    write(d_file, d_hasher.hash(pixels, jobs));
+
+    d_tick_commands = std::ostringstream{};
+    d_num_commands = 0;
+}
+
+auto load_session(const std::string& filename, session& out) -> bool
+{
+    auto file = std::ifstream{filename, std::ios::binary};
+    if (!file) {
+        std::print("could not open session {}\n", filename);
+        return false;
+    }
+
+    auto reader = session_reader{file};
+    if (reader.read<std::uint32_t>() != session_magic || reader.read<std::uint32_t>() != session_version) {
+        std::print("{} is not a session file\n", filename);
+        return false;
+    }
+    out.seed = reader.read<std::uint64_t>();
+    out.world_tick = reader.read<std::uint64_t>();
+    out.player = reader.read_player();
+    out.keys.down = reader.read_keys();
+    out.keys.down_this_frame = reader.read_keys();
+    out.view = reader.read<viewport>();
+    out.initial_save = reader.read_bytes(reader.read<std::uint64_t>());
+    if (!reader.ok()) {
+        std::print("{} is truncated\n", filename);
+        return false;
+    }
+
+    // A session cut short, say by a crash, replays up to its last complete tick
+    out.ticks.clear();
+    while (!reader.at_end()) {
+        auto tick = session_tick{};
+        const auto count = reader.read<std::uint32_t>();
+        for (std::uint32_t i = 0; i != count && reader.ok(); ++i) {
+            if (auto cmd = reader.read_command()) {
+                tick.commands.push_back(std::move(*cmd));
+            }
+        }
+        tick.hash = reader.read<std::uint64_t>();
+        if (!reader.ok()) break;
+        out.ticks.push_back(std::move(tick));
+    }
+    return true;
+}
+
+auto replay_session(session s, job_system& jobs) -> replay_result
+{
+    auto result = replay_result{};
+
+    auto initial = std::make_unique<world>();
+    auto in = std::istringstream{s.initial_save};
+    if (!load_world(*initial, in, "session", jobs)) {
+        return result;
+    }
+
+    auto sim = simulation{jobs, run_mode::manual};
+    sim.restore(std::move(*initial), s.world_tick, s.player, s.keys, s.view);
+    sand::seed_random(s.seed);
+
+    auto hasher = world_hasher{};
+    hasher.hash(sim.current_world(), jobs);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (auto& tick : s.ticks) {
+        for (auto& cmd : tick.commands) {
+            sim.push(std::move(cmd));
+        }
+        sim.step();
+        if (hasher.hash(sim.current_world(), jobs) != tick.hash) {
+            if (!result.first_mismatch) {
+                result.first_mismatch = result.ticks;
+            }
+            ++result.mismatches;
+        }
+        ++result.ticks;
+    }
+    result.duration = std::chrono::steady_clock::now() - start;
+    return result;
+}
+
+}
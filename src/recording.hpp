@@ -0,0 +1,100 @@
+#pragma once
+#include "world.hpp"
+#include "player.hpp"
+#include "mouse.hpp"
+#include "level_of_detail.hpp"
+#include "simulation.hpp"
+#include "job_system.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace sand {
+
+// Hashes a world chunk by chunk, only rehashing the chunks modified since the last call,
+// so hashing every tick costs in proportion to what changed
+class world_hasher
+{
+    std::vector<std::uint64_t> d_chunk_hashes;
+    std::uint64_t              d_next_tick = 0;
+
+public:
+    auto hash(const world& pixels, job_system& jobs) -> std::uint64_t;
+};
+
+// Writes a session file as the simulation runs: the world, player, held keys and view
+// when the recording started along with the seed the random numbers were restarted
+// from, then for every tick the commands applied before it and a hash of the world
+// after it. The physics scene is rebuilt when recording starts, as Box2D's state can't
+// be saved, and a replay rebuilds it the same way. With no update budget the simulation
+// is deterministic given these, so a session replays exactly.
+class session_recorder
+{
+    std::ofstream      d_file;
+    std::ostringstream d_tick_commands;
+    std::uint32_t      d_num_commands = 0;
+    world_hasher       d_hasher;
+
+    session_recorder() = default;
+
+public:
+    // Returns null if the file can't be written. The world is replaced by its saved
+    // form, which is what a replay starts from
+    static auto create(
+        const std::string& filename,
+        world& pixels,
+        const player_state& player,
+        const keyboard_state& keys,
+        const viewport& view,
+        std::uint64_t seed,
+        job_system& jobs
+    ) -> std::unique_ptr<session_recorder>;
+
+    // Returns false if the command changes the simulation in a way that can't be
+    // recorded, such as loading a world, which ends the recording. Commands with no
+    // effect on the simulation are accepted but not written.
+    auto record(const command& cmd) -> bool;
+
+    // Writes the commands recorded since the last tick and the hash of the world
+    auto end_tick(const world& pixels, job_system& jobs) -> void;
+};
+
+struct session_tick
+{
+    std::vector<command> commands;
+    std::uint64_t        hash = 0;
+};
+
+struct session
+{
+    std::uint64_t             seed = 0;
+    std::uint64_t             world_tick = 0;
+    player_state              player = {};
+    keyboard_state            keys = {};
+    viewport                  view = {};
+    std::string               initial_save;
+    std::vector<session_tick> ticks;
+};
+
+auto load_session(const std::string& filename, session& out) -> bool;
+
+struct replay_result
+{
+    std::size_t                ticks      = 0;
+    std::size_t                mismatches = 0;
+    std::optional<std::size_t> first_mismatch;
+    std::chrono::nanoseconds   duration   = {};
+};
+
+// Runs the session as fast as possible on the calling thread, comparing the world hash
+// after every tick with the recorded one and noting the first tick that diverges. The
+// commands are moved out of the session.
+auto replay_session(session s, job_system& jobs) -> replay_result;
+
+}
@@ -1,13 +1,15 @@
-#include "world.hpp"
 #include "pixel.hpp"
 #include "config.hpp"
 #include "utility.hpp"
 #include "editor.hpp"
 #include "camera.hpp"
-#include "update.hpp"
 #include "explosion.hpp"
 #include "mouse.hpp"
-#include "player.hpp"
+#include "simulation.hpp"
+#include "save_manager.hpp"
+#include "job_system.hpp"
+#include "recording.hpp"
+#include "video.hpp"
 
 #include "graphics/renderer.hpp"
 #include "graphics/player_renderer.hpp"
@@ -16,69 +18,51 @@
 
 #include <glm/glm.hpp>
 #include <imgui/imgui.h>
-#include <box2d/box2d.h>
 
-#include <memory>
+#include <chrono>
 #include <print>
+#include <string_view>
 
-// Converts a point in pixel space to world space
+namespace {
 
-
-class static_physics_box
+// Replays a recorded session without a window, as fast as it will run
+auto replay(const std::string& filename) -> int
 {
-    int       d_width;
-    int       d_height;
-    glm::vec3 d_colour;
-    b2Body*   d_body = nullptr;
-
-public:
-    static_physics_box(b2World& world, glm::vec2 pos, int width, int height, glm::vec3 colour, float angle = 0.0f)
-        : d_width{width}
-        , d_height{height}
-        , d_colour{colour}
-    {
-        b2BodyDef bodyDef;
-        bodyDef.type = b2_staticBody;
-        const auto position = sand::pixel_to_physics(pos);
-        bodyDef.position.Set(position.x, position.y);
-        bodyDef.angle = angle;
-        d_body = world.CreateBody(&bodyDef);
-
-        b2PolygonShape box;
-        const auto dimensions = sand::pixel_to_physics({width, height});
-        box.SetAsBox(dimensions.x / 2, dimensions.y / 2);
-
-        b2FixtureDef fixtureDef;
-        fixtureDef.shape = &box;
-        fixtureDef.friction = 1.0;
-        d_body->CreateFixture(&fixtureDef);
+    auto jobs = sand::job_system{};
+    auto session = sand::session{};
+    if (!sand::load_session(filename, session)) {
+        return 1;
     }
 
-    auto rect_pixels() const -> glm::vec4 {
-        auto pos = sand::physics_to_pixel(d_body->GetPosition());
-        return glm::vec4{pos.x, pos.y, d_width, d_height};
+    const auto result = sand::replay_session(std::move(session), jobs);
+    const auto seconds = std::chrono::duration<double>{result.duration}.count();
+    std::print("replayed {} ticks in {:.3f}s, {:.1f} ticks/s\n",
+               result.ticks, seconds, seconds > 0.0 ? result.ticks / seconds : 0.0);
+    if (result.first_mismatch) {
+        std::print("{} ticks did not match the recording, the first was tick {}\n",
+                   result.mismatches, *result.first_mismatch);
+        return 1;
     }
+    return 0;
+}
 
-    auto angle() const -> float {
-        return d_body->GetAngle();
-    }
+}
 
-    auto colour() const -> glm::vec3 {
-        return d_colour;
+auto main(int argc, char** argv) -> int
+{
+    if (argc == 3 && std::string_view{argv[1]} == "--replay") {
+        return replay(argv[2]);
     }
-};
 
-auto main() -> int
-{
     auto exe_path = sand::get_executable_filepath().parent_path();
     std::print("Executable directory: {}\n", exe_path.string());
     auto window = sand::window{"sandfall", 1280, 720};
     auto editor = sand::editor{};
     auto mouse = sand::mouse{};
-    auto keyboard = sand::keyboard{};
-
-    auto gravity = b2Vec2{0.0f, 10.0f};
-    auto physics = b2World{gravity};
+    auto jobs = sand::job_system{};
+    auto sim = sand::simulation{jobs};
+    auto saves = sand::save_manager{jobs};
+    auto playback = sand::video_playback{};
 
     auto camera = sand::camera{
         .top_left = {0, 0},
@@ -97,7 +81,28 @@ auto main() -> int
         }
 
         mouse.on_event(event);
-        keyboard.on_event(event);
+
+        if (event.is<sand::keyboard_pressed_event>()) {
+            const auto& e = event.as<sand::keyboard_pressed_event>();
+            if (e.mods & sand::modifier_control) {
+                if (e.key == static_cast<int>(sand::keyboard_key::Z)) {
+                    sim.push(sand::undo_command{});
+                    return;
+                }
+                if (e.key == static_cast<int>(sand::keyboard_key::Y)) {
+                    sim.push(sand::redo_command{});
+                    return;
+                }
+            }
+        }
+
+        // The player is driven by the simulation thread, so key presses are forwarded to it
+        if (event.is<sand::keyboard_pressed_event>()) {
+            sim.push(sand::key_command{.key = event.as<sand::keyboard_pressed_event>().key, .pressed = true});
+        }
+        else if (event.is<sand::keyboard_released_event>()) {
+            sim.push(sand::key_command{.key = event.as<sand::keyboard_released_event>().key, .pressed = false});
+        }
 
         if (mouse.is_down(sand::mouse_button::right) && event.is<sand::mouse_moved_event>()) {
             const auto& e = event.as<sand::mouse_moved_event>();
@@ -117,104 +122,125 @@ auto main() -> int
         }
     });
 
-    auto world           = std::make_unique<sand::world>();
-    auto world_renderer  = sand::renderer{};
+    auto world_renderer  = sand::renderer{jobs};
+    auto video_renderer  = sand::renderer{jobs};
     auto ui              = sand::ui{window};
-    auto accumulator     = 0.0;
     auto timer           = sand::timer{};
     auto player_renderer = sand::player_renderer{};
-    auto player          = sand::player_controller(physics, 10, 20);
-
-    auto ground = std::vector<static_physics_box>{
-        {physics, {128, 256 + 5}, 256, 10, {1.0, 1.0, 0.0}},
-        {physics, {200, 256 + 5}, 30, 50, {1.0, 1.0, 0.0}, 0.1},
-        {physics, {100, 256 + 5}, 30, 50, {1.0, 1.0, 0.0}},
-        {physics, {101, 256 + 4}, 30, 50, {1.0, 1.0, 0.0}},
-        {physics, {102, 256 + 3}, 30, 50, {1.0, 1.0, 0.0}},
-        {physics, {103, 256 + 2}, 30, 50, {1.0, 1.0, 0.0}},
-        {physics, {104, 256 + 1}, 30, 50, {1.0, 1.0, 0.0}},
-        {physics, {105, 256 + 0}, 30, 50, {1.0, 1.0, 0.0}},
-        {physics, {106, 255}, 30, 50, {1.0, 1.0, 0.0}},
-        {physics, {107, 254}, 30, 50, {1.0, 1.0, 0.0}},
-        {physics, {108, 253}, 30, 50, {1.0, 1.0, 0.0}},
-        {physics, {109, 252}, 30, 50, {1.0, 1.0, 0.0}},
-        {physics, {110, 251}, 30, 50, {1.0, 1.0, 0.0}},
-        {physics, {111, 250}, 30, 50, {1.0, 1.0, 0.0}},
-        {physics, {112, 249}, 30, 50, {1.0, 1.0, 0.0}},
-        {physics, {113, 248}, 30, 50, {1.0, 1.0, 0.0}},
-
-        {physics, {40, 215}, 430, 10, {1.0, 1.0, 0.0}, 1.4f}
-    };
+    auto last_view       = sand::viewport{};
 
     while (window.is_running()) {
-        const double dt = timer.on_update();
+        timer.on_update();
 
         mouse.on_new_frame();
-        keyboard.on_new_frame();
         
         window.poll_events();
         window.clear();
 
-        accumulator += dt;
-        bool updated = false;
-        while (accumulator > sand::config::time_step) {
-            sand::update(*world);
-            player.update(keyboard);
-            physics.Step(sand::config::time_step, 8, 3);
-            accumulator -= sand::config::time_step;
-            updated = true;
-        }
-
+        // Edits are sent to the simulation and show up in a later snapshot
         const auto mouse_pos = pixel_at_mouse(window, camera);
+        const auto type = editor.get_pixel().type;
+
+        // Everything painted while the button is held is undone as one stroke
+        if (mouse.is_down_this_frame(sand::mouse_button::left)) {
+            sim.push(sand::begin_edit_command{});
+        }
         switch (editor.brush_type) {
             break; case 0:
                 if (mouse.is_down(sand::mouse_button::left)) {
-                    const auto coord = mouse_pos + sand::random_from_circle(editor.brush_size);
-                    if (world->valid(coord)) {
-                        world->set(coord, editor.get_pixel());
-                        updated = true;
-                    }
+                    sim.push(sand::spray_command{
+                        .centre = mouse_pos, .radius = editor.brush_size, .type = type
+                    });
                 }
             break; case 1:
                 if (mouse.is_down(sand::mouse_button::left)) {
-                    const auto half_extent = (int)(editor.brush_size / 2);
-                    for (int x = mouse_pos.x - half_extent; x != mouse_pos.x + half_extent + 1; ++x) {
-                        for (int y = mouse_pos.y - half_extent; y != mouse_pos.y + half_extent + 1; ++y) {
-                            if (world->valid({x, y})) {
-                                world->set({x, y}, editor.get_pixel());
-                                updated = true;
-                            }
-                        }
-                    }
+                    sim.push(sand::square_command{
+                        .centre = mouse_pos, .half_extent = (int)(editor.brush_size / 2), .type = type
+                    });
                 }
             break; case 2:
                 if (mouse.is_down_this_frame(sand::mouse_button::left)) {
-                    sand::apply_explosion(*world, mouse_pos, sand::explosion{
-                        .min_radius = 40.0f, .max_radius = 45.0f, .scorch = 10.0f
+                    sim.push(sand::explosion_command{
+                        .centre = mouse_pos,
+                        .info = {.min_radius = 40.0f, .max_radius = 45.0f, .scorch = 10.0f}
                     });
-                    updated = true;
                 }
+            break; case 3:
+                if (mouse.is_down(sand::mouse_button::left)) {
+                    sim.push(sand::circle_command{
+                        .centre = mouse_pos, .radius = editor.brush_size, .type = type
+                    });
+                }
+            break; case 4:
+                if (mouse.is_down_this_frame(sand::mouse_button::left)) {
+                    sim.push(sand::flood_fill_command{.centre = mouse_pos, .type = type});
+                }
+            break; case 5:
+                if (mouse.is_down(sand::mouse_button::left)) {
+                    sim.push(sand::replace_command{
+                        .centre = mouse_pos, .half_extent = (int)(editor.brush_size / 2), .type = type
+                    });
+                }
+            break; case 6:
+                // Copied from the latest snapshot when the button is let go
+                if (mouse.is_down_this_frame(sand::mouse_button::left)) {
+                    editor.copy_start = mouse_pos;
+                }
+                else if (editor.copy_start && !mouse.is_down(sand::mouse_button::left)) {
+                    auto stamp = sand::copy_stamp(sim.latest().pixels, *editor.copy_start, mouse_pos);
+                    if (!stamp.empty()) {
+                        editor.clipboard = std::make_shared<const sand::region_stamp>(std::move(stamp));
+                    }
+                    editor.copy_start.reset();
+                }
+            break; case 7:
+                if (editor.clipboard && mouse.is_down_this_frame(sand::mouse_button::left)) {
+                    sim.push(sand::paste_command{
+                        .top_left = mouse_pos - editor.clipboard->size / 2, .stamp = editor.clipboard
+                    });
+                }
+        }
+
+        // Let the simulation know what is on screen so it can prioritise it
+        const auto view = sand::viewport{
+            .top_left = camera.top_left,
+            .size = glm::vec2{camera.screen_width, camera.screen_height} / camera.world_to_screen
+        };
+        if (view.top_left != last_view.top_left || view.size != last_view.size) {
+            sim.push(sand::view_command{view});
+            last_view = view;
+        }
+
+        // Draw whatever the simulation last published, without waiting for it
+        sim.acquire_snapshot();
+        const auto& snap = sim.latest();
+        if (editor.autosave_interval > 0) {
+            saves.autosave(snap.pixels, "autosave.bin", std::chrono::seconds{editor.autosave_interval});
         }
         
         // Renders the UI but doesn't yet draw on the screen
         ui.begin_frame();
-        if (display_ui(editor, *world, physics, timer, window, camera, player)) {
-            updated = true;
-        }
+        display_ui(editor, sim, saves, playback, snap, timer, window, camera);
 
-        // Render and display the world
-        world_renderer.bind();
-        if (updated) {
-            world_renderer.update(*world, editor.show_chunks, camera);
+        // An open video is shown in place of the world, which carries on underneath
+        if (playback.player) {
+            video_renderer.bind();
+            video_renderer.update(*playback.pixels, false, camera);
+            video_renderer.draw();
         }
-        world_renderer.draw();
-
-        // Render and display the player plus some temporary obstacles
-        player_renderer.bind();
-        player_renderer.draw(*world, player.rect_pixels(), player.angle(), glm::vec3{0.0, 1.0, 0.0}, camera);
-
-        for (const auto& obj : ground) {
-            player_renderer.draw(*world, obj.rect_pixels(), obj.angle(), obj.colour(), camera);
+        else {
+            // Render and display the world
+            world_renderer.bind();
+            world_renderer.update(snap.pixels, editor.show_chunks, camera);
+            world_renderer.draw();
+
+            // Render and display the player plus some temporary obstacles
+            player_renderer.bind();
+            player_renderer.draw(snap.pixels, snap.player.rect, snap.player.angle, snap.player.colour, camera);
+
+            for (const auto& body : snap.bodies) {
+                player_renderer.draw(snap.pixels, body.rect, body.angle, body.colour, camera);
+            }
         }
         
         // Display the UI
@@ -0,0 +1,529 @@
+#include "save.hpp"
+#include "binary_io.hpp"
+#include "config.hpp"
+#include "job_system.hpp"
+#include "lz.hpp"
+
+#include <cereal/archives/binary.hpp>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <print>
+#include <span>
+#include <vector>
+
+namespace sand {
+namespace {
+
+static constexpr std::uint32_t save_magic = four_cc("SAND");
+
+// Version 1 added the header and chunk states, version 2 the compressed chunks and
+// version 3 sets of changed chunks appended after them
+static constexpr std::uint32_t save_version = 3;
+
+// Starts each set of chunks appended by an incremental save
+static constexpr std::uint32_t delta_magic = four_cc("DLTA");
+
+using bytes = std::vector<std::uint8_t>;
+
+struct save_header
+{
+    std::uint32_t magic      = save_magic;
+    std::uint32_t version    = save_version;
+    std::int32_t  width      = 0;
+    std::int32_t  height     = 0;
+    std::int32_t  chunk_size = 0;
+
+    auto serialise(auto& archive) -> void
+    {
+        archive(magic, version, width, height, chunk_size);
+    }
+};
+
+// Legacy saves start with a pixel, so never with the magic number
+auto has_header(std::istream& file) -> bool
+{
+    const auto start = file.tellg();
+    auto magic = std::uint32_t{0};
+    const auto result = read(file, magic) && magic == save_magic;
+    file.clear();
+    file.seekg(start);
+    return result;
+}
+
+// Reads values from a decompressed chunk, every read is bounds checked and failures
+// are sticky so they only need checking at the end
+class chunk_reader
+{
+    std::span<const std::uint8_t> d_data;
+    std::size_t                   d_pos = 0;
+    bool                          d_ok  = true;
+
+public:
+    explicit chunk_reader(std::span<const std::uint8_t> data) : d_data{data} {}
+
+    auto ok() const -> bool { return d_ok; }
+    auto done() const -> bool { return d_ok && d_pos == d_data.size(); }
+
+    auto take(std::size_t count) -> std::span<const std::uint8_t>
+    {
+        if (!d_ok || count > d_data.size() - d_pos) {
+            d_ok = false;
+            return {};
+        }
+        const auto result = d_data.subspan(d_pos, count);
+        d_pos += count;
+        return result;
+    }
+
+    auto byte() -> std::uint8_t
+    {
+        const auto data = take(1);
+        return data.empty() ? 0 : data[0];
+    }
+
+    auto fail() -> void { d_ok = false; }
+};
+
+// A chunk is stored as its state, then its pixels in local row-major order split into
+// planes: the types as runs of indices into a palette of the types present, a shade
+// byte, the low byte of the flags, the power and finally the velocity of the falling
+// pixels only, as the rest are at rest with the velocity an update leaves them. The
+// planes are then compressed.
+template <typename Geometry>
+auto encode_chunk(const basic_world<Geometry>& pixels, std::size_t index) -> bytes
+{
+    const auto& chunk = pixels.get_chunks()[index];
+    const auto origin = pixels.get_chunk_pos(index) * pixels.chunk_size();
+    const auto size = pixels.chunk_size();
+
+    auto cells = std::vector<const pixel*>{};
+    cells.reserve(pixels.chunk_area());
+    for (int y = 0; y != size; ++y) {
+        for (int x = 0; x != size; ++x) {
+            cells.push_back(&pixels.at(origin + glm::ivec2{x, y}));
+        }
+    }
+
+    auto raw = bytes{};
+    raw.push_back(static_cast<std::uint8_t>(chunk.should_step | (chunk.should_step_next << 1)));
+    raw.push_back(static_cast<std::uint8_t>(chunk.lag));
+
+    auto palette = std::array<std::uint8_t, num_pixel_types>{};
+    auto palette_size = std::uint8_t{0};
+    for (std::size_t type = 0; type != num_pixel_types; ++type) {
+        if (chunk.type_counts[type] > 0) {
+            palette[type] = palette_size++;
+        }
+    }
+    raw.push_back(palette_size);
+    for (std::size_t type = 0; type != num_pixel_types; ++type) {
+        if (chunk.type_counts[type] > 0) {
+            raw.push_back(static_cast<std::uint8_t>(type));
+        }
+    }
+
+    for (std::size_t i = 0; i != cells.size();) {
+        const auto type = cells[i]->type;
+        auto run = std::size_t{1};
+        while (i + run != cells.size() && run != 255 && cells[i + run]->type == type) {
+            ++run;
+        }
+        raw.push_back(palette[static_cast<std::size_t>(type)]);
+        raw.push_back(static_cast<std::uint8_t>(run));
+        i += run;
+    }
+
+    for (const auto* cell : cells) raw.push_back(cell->shade);
+    for (const auto* cell : cells) raw.push_back(static_cast<std::uint8_t>(cell->flags.to_ullong() & 0xff));
+    for (const auto* cell : cells) raw.push_back(cell->power);
+    for (const auto* cell : cells) {
+        if (cell->flags[pixel_flags::is_falling]) {
+            const auto offset = raw.size();
+            raw.resize(offset + sizeof(glm::vec2));
+            std::memcpy(raw.data() + offset, &cell->velocity, sizeof(glm::vec2));
+        }
+    }
+
+    auto compressed = lz_compress(raw);
+    auto block = bytes(2 * sizeof(std::uint32_t));
+    const auto sizes = std::array{
+        static_cast<std::uint32_t>(compressed.size()), static_cast<std::uint32_t>(raw.size())
+    };
+    std::memcpy(block.data(), sizes.data(), block.size());
+    block.insert(block.end(), compressed.begin(), compressed.end());
+    return block;
+}
+
+template <typename Geometry>
+auto decode_chunk(basic_world<Geometry>& pixels, std::size_t index, std::span<const std::uint8_t> raw) -> bool
+{
+    const auto origin = pixels.get_chunk_pos(index) * pixels.chunk_size();
+    const auto size = pixels.chunk_size();
+    const auto area = static_cast<std::size_t>(pixels.chunk_area());
+    const auto cell = [&](std::size_t i) -> pixel& {
+        return pixels.at(origin + glm::ivec2{static_cast<int>(i) % size, static_cast<int>(i) / size});
+    };
+
+    auto reader = chunk_reader{raw};
+    const auto state = reader.byte();
+    const auto lag = reader.byte();
+
+    const auto palette = reader.take(reader.byte());
+    for (const auto type : palette) {
+        if (type >= num_pixel_types) reader.fail();
+    }
+
+    for (std::size_t i = 0; reader.ok() && i != area;) {
+        const auto entry = reader.byte();
+        const auto run = std::size_t{reader.byte()};
+        if (entry >= palette.size() || run == 0 || run > area - i) {
+            reader.fail();
+            break;
+        }
+        // Pixels under gravity that stopped falling were left ready to move a block
+        const auto type = static_cast<pixel_type>(palette[entry]);
+        const auto velocity = properties(type).gravity_factor != 0.0f ? glm::vec2{0.0f, 1.0f} : glm::vec2{0.0f, 0.0f};
+        for (const auto end = i + run; i != end; ++i) {
+            cell(i) = pixel{.type = type, .colour = {}, .velocity = velocity, .flags = {}};
+        }
+    }
+
+    const auto shades = reader.take(area);
+    const auto flags = reader.take(area);
+    const auto power = reader.take(area);
+    if (!reader.ok()) return false;
+
+    for (std::size_t i = 0; i != area; ++i) {
+        auto& px = cell(i);
+        px.colour = from_shade(px.type, shades[i]);
+        px.shade = shades[i];
+        px.flags = std::bitset<64>{flags[i]};
+        px.power = power[i];
+        if (px.flags[pixel_flags::is_falling]) {
+            const auto velocity = reader.take(sizeof(glm::vec2));
+            if (!reader.ok()) return false;
+            std::memcpy(&px.velocity, velocity.data(), sizeof(glm::vec2));
+        }
+    }
+
+    pixels.restore_chunk_state(index, state & 0b01, state & 0b10, lag);
+    return reader.done();
+}
+
+// The largest a decompressed chunk can be: state, a full palette, a run per pixel, the
+// three byte planes and a velocity per pixel
+auto max_raw_size(std::size_t area) -> std::size_t
+{
+    return 3 + num_pixel_types + 2 * area + 3 * area + sizeof(glm::vec2) * area;
+}
+
+// A compressed chunk as read from a file, decoded once the whole file has been read
+struct chunk_block
+{
+    std::uint32_t index    = 0;
+    std::uint32_t raw_size = 0;
+    bytes         compressed;
+};
+
+auto read_block(std::istream& file, std::size_t area, chunk_block& block) -> bool
+{
+    auto compressed_size = std::uint32_t{0};
+    if (!read(file, compressed_size) || !read(file, block.raw_size)) {
+        return false;
+    }
+    if (block.raw_size > max_raw_size(area) || compressed_size > 2 * max_raw_size(area)) {
+        return false;
+    }
+    block.compressed.resize(compressed_size);
+    return read_bytes(file, block.compressed);
+}
+
+// Reads one set of appended chunks, returning false if it is cut short or malformed
+auto read_delta(std::istream& file, std::size_t num_chunks, std::size_t area, std::vector<chunk_block>& blocks) -> bool
+{
+    auto count = std::uint32_t{0};
+    if (!read(file, count) || count > num_chunks) {
+        return false;
+    }
+
+    // Chunks in a set are decoded in parallel, so each may only appear once
+    auto seen = std::vector<bool>(num_chunks);
+    blocks.resize(count);
+    for (auto& block : blocks) {
+        if (!read(file, block.index) || block.index >= num_chunks || seen[block.index]) {
+            return false;
+        }
+        seen[block.index] = true;
+        if (!read_block(file, area, block)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+auto begin_progress(save_progress* progress, std::size_t total) -> void
+{
+    if (!progress) return;
+    progress->done = 0;
+    progress->total = total;
+}
+
+auto advance_progress(save_progress* progress) -> void
+{
+    if (progress) ++progress->done;
+}
+
+template <typename Geometry>
+auto encode_chunks(
+    const basic_world<Geometry>& pixels,
+    std::span<const std::size_t> indices,
+    job_system& jobs,
+    save_progress* progress
+) -> std::vector<bytes>
+{
+    begin_progress(progress, indices.size());
+    auto blocks = std::vector<bytes>(indices.size());
+    jobs.parallel_for(indices.size(), chunks_per_encode_job, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i != end; ++i) {
+            blocks[i] = encode_chunk(pixels, indices[i]);
+            advance_progress(progress);
+        }
+    });
+    return blocks;
+}
+
+template <typename Geometry>
+auto decode_chunks(
+    basic_world<Geometry>& pixels,
+    std::span<const chunk_block> blocks,
+    job_system& jobs,
+    save_progress* progress
+) -> bool
+{
+    auto failed = std::atomic<bool>{false};
+    jobs.parallel_for(blocks.size(), chunks_per_encode_job, [&](std::size_t begin, std::size_t end) {
+        auto raw = bytes{};
+        for (std::size_t i = begin; i != end; ++i) {
+            const auto& block = blocks[i];
+            raw.resize(block.raw_size);
+            if (!lz_decompress(block.compressed, raw) || !decode_chunk(pixels, block.index, raw)) {
+                failed = true;
+            }
+            advance_progress(progress);
+        }
+    });
+    return !failed;
+}
+
+}
+
+template <typename Geometry>
+auto save_world(const basic_world<Geometry>& pixels, const std::string& filename, job_system& jobs, save_progress* progress) -> bool
+{
+    auto file = std::ofstream{filename, std::ios::binary};
+    if (!file) {
+        std::print("could not open {} for writing\n", filename);
+        return false;
+    }
+    return save_world(pixels, file, jobs, progress);
+}
+
+template <typename Geometry>
+auto save_world(const basic_world<Geometry>& pixels, std::ostream& file, job_system& jobs, save_progress* progress) -> bool
+{
+    auto indices = std::vector<std::size_t>(pixels.get_chunks().size());
+    std::iota(indices.begin(), indices.end(), std::size_t{0});
+    const auto blocks = encode_chunks(pixels, indices, jobs, progress);
+
+    {
+        auto archive = cereal::BinaryOutputArchive{file};
+        auto header = save_header{
+            .width = pixels.width(), .height = pixels.height(), .chunk_size = pixels.chunk_size()
+        };
+        archive(header);
+    }
+    for (const auto& block : blocks) {
+        write_bytes(file, block);
+    }
+    return static_cast<bool>(file);
+}
+
+template <typename Geometry>
+auto append_world_changes(
+    const basic_world<Geometry>& pixels,
+    const std::string& filename,
+    std::uint64_t since_tick,
+    job_system& jobs,
+    save_progress* progress
+) -> bool
+{
+    if (!std::filesystem::exists(filename)) {
+        std::print("{} does not exist to append to\n", filename);
+        return false;
+    }
+
+    auto indices = std::vector<std::size_t>{};
+    const auto& chunks = pixels.get_chunks();
+    for (std::size_t index = 0; index != chunks.size(); ++index) {
+        if (chunks[index].modified_tick >= since_tick) {
+            indices.push_back(index);
+        }
+    }
+    const auto blocks = encode_chunks(pixels, indices, jobs, progress);
+
+    // Built up front so the set goes to the file in one write, which makes it less
+    // likely to be cut short. One that is gets ignored when loading.
+    auto delta = bytes{};
+    append(delta, delta_magic);
+    append(delta, static_cast<std::uint32_t>(indices.size()));
+    for (std::size_t i = 0; i != indices.size(); ++i) {
+        append(delta, static_cast<std::uint32_t>(indices[i]));
+        delta.insert(delta.end(), blocks[i].begin(), blocks[i].end());
+    }
+
+    auto file = std::ofstream{filename, std::ios::binary | std::ios::app};
+    if (!file) {
+        std::print("could not open {} for writing\n", filename);
+        return false;
+    }
+    write_bytes(file, delta);
+    return static_cast<bool>(file);
+}
+
+// Legacy and version 1 saves are read through cereal, which throws if the file is cut
+// short or holds a pixel type that doesn't exist. A partly read world is cleared.
+template <typename Geometry>
+auto load_archived(
+    basic_world<Geometry>& pixels,
+    cereal::BinaryInputArchive& archive,
+    bool chunk_states,
+    const std::string& filename
+) -> bool
+{
+    try {
+        archive(pixels);
+        if (chunk_states) {
+            pixels.load_chunk_states(archive);
+        } else {
+            pixels.wake_all_chunks();
+        }
+        return true;
+    } catch (const cereal::Exception& e) {
+        std::print("{} is corrupt: {}\n", filename, e.what());
+        pixels.fill(pixel::air());
+        pixels.wake_all_chunks();
+        pixels.end_restore();
+        return false;
+    }
+}
+
+template <typename Geometry>
+auto load_world(basic_world<Geometry>& pixels, const std::string& filename, job_system& jobs, save_progress* progress) -> bool
+{
+    auto file = std::ifstream{filename, std::ios::binary};
+    if (!file) {
+        std::print("could not open {}\n", filename);
+        return false;
+    }
+    return load_world(pixels, file, filename, jobs, progress);
+}
+
+template <typename Geometry>
+auto load_world(basic_world<Geometry>& pixels, std::istream& file, const std::string& filename, job_system& jobs, save_progress* progress) -> bool
+{
+    auto archive = cereal::BinaryInputArchive{file};
+    if (!has_header(file)) {
+        return load_archived(pixels, archive, false, filename);
+    }
+
+    auto header = save_header{};
+    try {
+        archive(header);
+    } catch (const cereal::Exception&) {
+        std::print("{} is truncated\n", filename);
+        return false;
+    }
+    if (header.version > save_version) {
+        std::print("{} is from a newer version (version {})\n", filename, header.version);
+        return false;
+    }
+    if (header.width != pixels.width() || header.height != pixels.height()) {
+        std::print("{} is for a {}x{} world\n", filename, header.width, header.height);
+        return false;
+    }
+
+    if (header.version == 1) {
+        return load_archived(pixels, archive, header.chunk_size == pixels.chunk_size(), filename);
+    }
+
+    // Chunks are decoded straight into the world, so can't load into one with a
+    // different chunk size
+    if (header.chunk_size != pixels.chunk_size()) {
+        std::print("{} has {} pixel chunks\n", filename, header.chunk_size);
+        return false;
+    }
+
+    // The full save, then any sets of changed chunks appended to it, in order
+    const auto num_chunks = pixels.get_chunks().size();
+    const auto area = static_cast<std::size_t>(pixels.chunk_area());
+    auto layers = std::vector<std::vector<chunk_block>>(1);
+    layers[0].resize(num_chunks);
+    for (std::size_t index = 0; index != num_chunks; ++index) {
+        layers[0][index].index = static_cast<std::uint32_t>(index);
+        if (!read_block(file, area, layers[0][index])) {
+            std::print("{} is truncated or corrupt\n", filename);
+            return false;
+        }
+    }
+
+    auto magic = std::uint32_t{0};
+    while (header.version >= 3 && read(file, magic)) {
+        auto blocks = std::vector<chunk_block>{};
+        if (magic != delta_magic || !read_delta(file, num_chunks, area, blocks)) {
+            std::print("{} ends with an incomplete save, loading up to the one before\n", filename);
+            break;
+        }
+        layers.push_back(std::move(blocks));
+    }
+
+    auto total = std::size_t{0};
+    for (const auto& layer : layers) total += layer.size();
+    begin_progress(progress, total);
+
+    // Decoding writes to the world as it goes, so a corrupt chunk leaves a partly loaded
+    // world; it is cleared rather than left as a mix of the two
+    for (const auto& layer : layers) {
+        if (!decode_chunks(pixels, layer, jobs, progress)) {
+            std::print("{} is corrupt\n", filename);
+            pixels.fill(pixel::air());
+            pixels.wake_all_chunks();
+            pixels.end_restore();
+            return false;
+        }
+    }
+    pixels.end_restore();
+    return true;
+}
+
+template auto save_world(const basic_world<sand::config::geometry>&, const std::string&, job_system&, save_progress*) -> bool;
+template auto save_world(const basic_world<dynamic_geometry>&, const std::string&, job_system&, save_progress*) -> bool;
+template auto load_world(basic_world<sand::config::geometry>&, const std::string&, job_system&, save_progress*) -> bool;
+template auto load_world(basic_world<dynamic_geometry>&, const std::string&, job_system&, save_progress*) -> bool;
+template auto save_world(const basic_world<sand::config::geometry>&, std::ostream&, job_system&, save_progress*) -> bool;
+template auto save_world(const basic_world<dynamic_geometry>&, std::ostream&, job_system&, save_progress*) -> bool;
+template auto load_world(basic_world<sand::config::geometry>&, std::istream&, const std::string&, job_system&, save_progress*) -> bool;
+template auto load_world(basic_world<dynamic_geometry>&, std::istream&, const std::string&, job_system&, save_progress*) -> bool;
+template auto append_world_changes(const basic_world<sand::config::geometry>&, const std::string&, std::uint64_t, job_system&, save_progress*) -> bool;
+template auto append_world_changes(const basic_world<dynamic_geometry>&, const std::string&, std::uint64_t, job_system&, save_progress*) -> bool;
+
+}
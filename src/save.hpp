@@ -0,0 +1,56 @@
+#pragma once
+#include "world.hpp"
+#include "job_system.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace sand {
+
+// Counts chunks as they are encoded or decoded, for showing progress while saving or
+// loading on another thread
+struct save_progress
+{
+    std::atomic<std::size_t> done  = 0;
+    std::atomic<std::size_t> total = 0;
+};
+
+// Save files start with a header holding a magic number, the format version and the
+// world geometry, followed by each chunk compressed on its own, so that chunks are
+// saved and loaded in parallel. See save.cpp for the chunk layout. Version 1 files,
+// which hold every pixel in full, still load, as do files from before the header
+// existed; those have every chunk woken as there is no way to know which had settled.
+template <typename Geometry>
+auto save_world(const basic_world<Geometry>& pixels, const std::string& filename, job_system& jobs, save_progress* progress = nullptr) -> bool;
+
+// Appends the chunks modified at or after since_tick to an existing save of this world,
+// so that saving often costs in proportion to what changed. Loading applies each set of
+// appended chunks in order on top of the full save, so the caller should write a new
+// full save once the appended sets add up to more than it.
+template <typename Geometry>
+auto append_world_changes(
+    const basic_world<Geometry>& pixels,
+    const std::string& filename,
+    std::uint64_t since_tick,
+    job_system& jobs,
+    save_progress* progress = nullptr
+) -> bool;
+
+// Returns false, leaving the world untouched, if the file can't be opened or is for a
+// different sized world. A corrupt file leaves the world empty.
+template <typename Geometry>
+auto load_world(basic_world<Geometry>& pixels, const std::string& filename, job_system& jobs, save_progress* progress = nullptr) -> bool;
+
+// The same, for saves embedded in other files. Loading reads to the end of the stream as
+// changes may have been appended, so the save needs a stream of its own. The name is for
+// error messages only.
+template <typename Geometry>
+auto save_world(const basic_world<Geometry>& pixels, std::ostream& out, job_system& jobs, save_progress* progress = nullptr) -> bool;
+
+template <typename Geometry>
+auto load_world(basic_world<Geometry>& pixels, std::istream& in, const std::string& name, job_system& jobs, save_progress* progress = nullptr) -> bool;
+
+}
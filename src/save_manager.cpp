@@ -0,0 +1,113 @@
+#include "save_manager.hpp"
+
+#include <filesystem>
+#include <format>
+#include <utility>
+
+namespace sand {
+
+save_manager::save_manager(job_system& jobs)
+    : d_jobs{&jobs}
+    , d_saving{std::make_unique<world>()}
+    , d_last_autosave{clock::now()}
+{
+}
+
+auto save_manager::set_status(std::string status) -> void
+{
+    const auto lock = std::scoped_lock{d_status_mutex};
+    d_status = std::move(status);
+}
+
+auto save_manager::save(const world& pixels, const std::string& filename) -> bool
+{
+    if (busy()) {
+        return false;
+    }
+    d_busy.store(true, std::memory_order_relaxed);
+    d_progress.done = 0;
+    d_progress.total = 0;
+    set_status(std::format("Saving {}", filename));
+
+    // The snapshot belongs to the render thread and is replaced on its next acquire, so
+    // the changes are copied out before returning
+    d_saving->sync_from(pixels, *d_jobs);
+
+    d_thread = std::jthread{[this, filename, tick = d_saving->tick()] {
+        auto& slot = d_slots[filename];
+        const auto incremental = slot.full_size > 0 && slot.appended_size < slot.full_size;
+        const auto ok = incremental
+            ? sand::append_world_changes(*d_saving, filename, slot.saved_tick, *d_jobs, &d_progress)
+            : sand::save_world(*d_saving, filename, *d_jobs, &d_progress);
+
+        auto error = std::error_code{};
+        const auto size = std::filesystem::file_size(filename, error);
+        if (!ok || error) {
+            d_slots.erase(filename);
+            set_status(std::format("Failed to save {}", filename));
+        } else {
+            if (incremental) {
+                slot.appended_size = size - slot.full_size;
+            } else {
+                slot.full_size = size;
+                slot.appended_size = 0;
+            }
+            slot.saved_tick = tick;
+            set_status(incremental ? std::format("Saved changes to {}", filename) : std::format("Saved {}", filename));
+        }
+        d_busy.store(false, std::memory_order_release);
+    }};
+    return true;
+}
+
+auto save_manager::load(const std::string& filename, simulation& sim) -> bool
+{
+    if (busy()) {
+        return false;
+    }
+    d_busy.store(true, std::memory_order_relaxed);
+    d_progress.done = 0;
+    d_progress.total = 0;
+    set_status(std::format("Loading {}", filename));
+
+    // Every chunk of the loaded world counts as modified, so the next save to any file
+    // would append all of them; a full save is smaller
+    d_slots.clear();
+
+    d_thread = std::jthread{[this, &sim, filename] {
+        auto loaded = std::make_unique<world>();
+        const auto ok = sand::load_world(*loaded, filename, *d_jobs, &d_progress);
+        if (ok) {
+            sim.push(replace_world_command{std::move(loaded)});
+        }
+        set_status(ok ? std::format("Loaded {}", filename) : std::format("Failed to load {}", filename));
+        d_busy.store(false, std::memory_order_release);
+    }};
+    return true;
+}
+
+auto save_manager::autosave(const world& pixels, const std::string& filename, std::chrono::seconds interval) -> void
+{
+    const auto now = clock::now();
+    if (now - d_last_autosave < interval) {
+        return;
+    }
+    // A manual save or load in progress just pushes the autosave back to the next frame
+    if (save(pixels, filename)) {
+        d_last_autosave = now;
+    }
+}
+
+auto save_manager::progress() const -> float
+{
+    const auto total = d_progress.total.load();
+    return total == 0 ? 0.0f : static_cast<float>(d_progress.done.load()) / total;
+}
+
+auto save_manager::status() const -> std::string
+{
+    const auto lock = std::scoped_lock{d_status_mutex};
+    return d_status;
+}
+
+}
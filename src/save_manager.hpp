@@ -0,0 +1,78 @@
+#pragma once
+#include "world.hpp"
+#include "save.hpp"
+#include "simulation.hpp"
+#include "job_system.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace sand {
+
+// Saves and loads worlds on a background thread so that the UI never waits on a file.
+// A save first brings a private copy of the world up to date with the snapshot being
+// saved, copying only the chunks that changed since the last save, and then encodes
+// and writes that copy. A load decodes into a new world and hands it to the
+// simulation, which swaps it in at the start of its next tick. One operation runs at
+// a time, requests made while busy are refused.
+//
+// Saving to the same file again only appends the chunks modified since the last save to
+// it, until the appended chunks add up to more than the full save, when it is rewritten.
+class save_manager
+{
+    using clock = std::chrono::steady_clock;
+
+    // What was last written to a file this session
+    struct save_slot
+    {
+        std::uint64_t  saved_tick    = 0;
+        std::uintmax_t full_size     = 0;
+        std::uintmax_t appended_size = 0;
+    };
+
+    job_system*            d_jobs;
+    std::unique_ptr<world> d_saving;
+    save_progress          d_progress;
+    std::atomic<bool>      d_busy = false;
+    clock::time_point      d_last_autosave;
+
+    // Only used by the background thread, or while no operation is running
+    std::unordered_map<std::string, save_slot> d_slots;
+
+    mutable std::mutex d_status_mutex;
+    std::string        d_status;
+
+    // Saves and loads the slots, stopped before the world being saved is destroyed
+    std::jthread d_thread;
+
+    auto set_status(std::string status) -> void;
+
+    save_manager(const save_manager&) = delete;
+    save_manager& operator=(const save_manager&) = delete;
+
+public:
+    explicit save_manager(job_system& jobs);
+
+    // Render thread only. Returns false if an operation is already running
+    auto save(const world& pixels, const std::string& filename) -> bool;
+    auto load(const std::string& filename, simulation& sim) -> bool;
+
+    // Saves to filename if at least interval has passed since the last autosave
+    auto autosave(const world& pixels, const std::string& filename, std::chrono::seconds interval) -> void;
+
+    auto busy() const -> bool { return d_busy.load(std::memory_order_acquire); }
+
+    // How far through the running operation is, from 0 to 1
+    auto progress() const -> float;
+
+    // What the running operation is doing, or how the last one went
+    auto status() const -> std::string;
+};
+
+}
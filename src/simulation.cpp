@@ -0,0 +1,342 @@
+#include "simulation.hpp"
+#include "update.hpp"
+#include "utility.hpp"
+#include "config.hpp"
+#include "event.hpp"
+#include "world_file.hpp"
+#include "recording.hpp"
+#include "video.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <print>
+#include <random>
+#include <utility>
+
+namespace sand {
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+static constexpr auto tick_length = std::chrono::duration_cast<clock::duration>(
+    std::chrono::duration<double>{sand::config::time_step}
+);
+
+// If the simulation falls further behind than this it gives up on the missed ticks
+// rather than trying to catch up, which would only put it further behind
+static constexpr auto max_lag = 5 * tick_length;
+
+auto to_snapshot(const auto& body, glm::vec3 colour) -> body_snapshot
+{
+    return {.rect = body.rect_pixels(), .angle = body.angle(), .colour = colour};
+}
+
+}
+
+static_physics_box::static_physics_box(b2World& world, glm::vec2 pos, int width, int height, glm::vec3 colour, float angle)
+    : d_width{width}
+    , d_height{height}
+    , d_colour{colour}
+{
+    b2BodyDef bodyDef;
+    bodyDef.type = b2_staticBody;
+    const auto position = sand::pixel_to_physics(pos);
+    bodyDef.position.Set(position.x, position.y);
+    bodyDef.angle = angle;
+    d_body = world.CreateBody(&bodyDef);
+
+    b2PolygonShape box;
+    const auto dimensions = sand::pixel_to_physics({width, height});
+    box.SetAsBox(dimensions.x / 2, dimensions.y / 2);
+
+    b2FixtureDef fixtureDef;
+    fixtureDef.shape = &box;
+    fixtureDef.friction = 1.0;
+    d_body->CreateFixture(&fixtureDef);
+}
+
+auto static_physics_box::rect_pixels() const -> glm::vec4
+{
+    auto pos = sand::physics_to_pixel(d_body->GetPosition());
+    return glm::vec4{pos.x, pos.y, d_width, d_height};
+}
+
+auto static_physics_box::angle() const -> float
+{
+    return d_body->GetAngle();
+}
+
+physics_scene::physics_scene()
+    : world{b2Vec2{0.0f, 10.0f}}
+    , player{world, 10, 20}
+{
+    bodies.emplace_back(world, glm::vec2{128, 256 + 5}, 256, 10, glm::vec3{1.0, 1.0, 0.0});
+    bodies.emplace_back(world, glm::vec2{200, 256 + 5}, 30, 50, glm::vec3{1.0, 1.0, 0.0}, 0.1f);
+    for (int i = 0; i != 14; ++i) {
+        bodies.emplace_back(world, glm::vec2{100 + i, 256 + 5 - i}, 30, 50, glm::vec3{1.0, 1.0, 0.0});
+    }
+    bodies.emplace_back(world, glm::vec2{40, 215}, 430, 10, glm::vec3{1.0, 1.0, 0.0}, 1.4f);
+}
+
+simulation::simulation(job_system& jobs, run_mode mode)
+    : d_jobs{&jobs}
+    , d_world{std::make_unique<world>()}
+    , d_physics{std::make_unique<physics_scene>()}
+    , d_view{.top_left = {0, 0}, .size = {d_world->width(), d_world->height()}}
+{
+    if (mode == run_mode::threaded) {
+        d_thread = std::jthread{[this](std::stop_token token) { run(token); }};
+    }
+}
+
+// Defined here where the recorder is a complete type
+simulation::~simulation() = default;
+
+auto simulation::push(command cmd) -> void
+{
+    const auto lock = std::scoped_lock{d_commands_mutex};
+    d_commands.push_back(std::move(cmd));
+}
+
+auto simulation::run(std::stop_token token) -> void
+{
+    auto rate = timer{};
+    auto commands = std::vector<command>{};
+    auto next = clock::now();
+
+    while (!token.stop_requested()) {
+        {
+            const auto lock = std::scoped_lock{d_commands_mutex};
+            std::swap(commands, d_commands);
+        }
+        apply_all(commands);
+        commands.clear();
+
+        tick();
+        rate.on_update();
+        publish(rate.frame_rate());
+
+        next += tick_length;
+        if (const auto now = clock::now(); now - next > max_lag) {
+            next = now;
+        }
+        std::this_thread::sleep_until(next);
+    }
+}
+
+auto simulation::step() -> void
+{
+    assert(!d_thread.joinable());
+    auto commands = std::vector<command>{};
+    {
+        const auto lock = std::scoped_lock{d_commands_mutex};
+        std::swap(commands, d_commands);
+    }
+    apply_all(commands);
+    tick();
+}
+
+auto simulation::restore(
+    world&& pixels,
+    std::uint64_t tick,
+    const player_state& player,
+    const keyboard_state& keys,
+    const viewport& view
+) -> void
+{
+    assert(!d_thread.joinable());
+    d_world->replace(std::move(pixels));
+    d_world->set_tick(tick);
+    d_physics = std::make_unique<physics_scene>();
+    d_physics->player.set_state(player);
+    d_keyboard.set_state(keys);
+    d_view = view;
+    d_budget = {};
+}
+
+auto simulation::apply_all(std::vector<command>& commands) -> void
+{
+    d_world->begin_edits();
+    for (auto& cmd : commands) {
+        if (d_recorder && !d_recorder->record(cmd)) {
+            std::print("stopped recording, a loaded world can't be recorded\n");
+            d_recorder.reset();
+        }
+        apply(cmd);
+    }
+}
+
+auto simulation::apply(command& cmd) -> void
+{
+    auto& pixels = *d_world;
+    const auto save_chunk = [&](std::size_t index) { d_history.save_chunk(pixels, index); };
+    std::visit(overloaded{
+        [&](const spray_command& c) {
+            const auto coord = c.centre + sand::random_from_circle(c.radius);
+            if (pixels.valid(coord)) {
+                d_history.save_region(pixels, coord, coord);
+                pixels.set(coord, make_pixel(c.type));
+            }
+        },
+        [&](const square_command& c) {
+            d_history.save_region(pixels, c.centre - c.half_extent, c.centre + c.half_extent);
+            pixels.fill_rect(c.centre - c.half_extent, glm::ivec2{2 * c.half_extent + 1}, c.type);
+        },
+        [&](const circle_command& c) {
+            const auto reach = static_cast<int>(c.radius);
+            d_history.save_region(pixels, c.centre - reach, c.centre + reach);
+            pixels.fill_circle(c.centre, c.radius, c.type);
+        },
+        [&](const flood_fill_command& c) {
+            d_history.begin();
+            pixels.flood_fill(c.centre, c.type, save_chunk);
+            d_history.begin();
+        },
+        [&](const replace_command& c) {
+            if (pixels.valid(c.centre)) {
+                const auto from = pixels.at(c.centre).type;
+                pixels.replace_type(c.centre - c.half_extent, glm::ivec2{2 * c.half_extent + 1}, from, c.type, save_chunk);
+            }
+        },
+        [&](const paste_command& c) {
+            const auto pasted = sand::decode_stamp(*c.stamp);
+            if (pasted.empty()) return;
+            d_history.begin();
+            d_history.save_region(pixels, c.top_left, c.top_left + c.stamp->size - 1);
+            d_history.begin();
+            pixels.blit(c.top_left, c.stamp->size, pasted);
+        },
+        [&](const explosion_command& c) {
+            // Scorching reaches a random distance past the blast, more than five standard
+            // deviations is too unlikely to be worth copying the chunks for
+            const auto reach = static_cast<int>(std::ceil(c.info.max_radius + 5 * c.info.scorch)) + 1;
+            d_history.begin();
+            d_history.save_region(pixels, c.centre - reach, c.centre + reach);
+            d_history.begin();
+            sand::apply_explosion(pixels, c.centre, c.info, *d_jobs);
+        },
+        [&](const clear_command&) {
+            d_history.begin();
+            d_history.save_all(pixels);
+            d_history.begin();
+            pixels.wake_all_chunks();
+            pixels.fill(sand::pixel::air());
+        },
+        [&](replace_world_command& c) {
+            d_history.begin();
+            d_history.save_all(pixels);
+            d_history.begin();
+            pixels.replace(std::move(*c.pixels));
+        },
+        [&](const map_world_command& c) {
+            const auto mapped = std::filesystem::exists(c.filename)
+                ? sand::open_world_file(pixels, c.filename, *d_jobs)
+                : sand::create_world_file(pixels, c.filename);
+
+            // Undoing past here would write the previous world into the file
+            if (mapped) {
+                d_history.clear();
+            }
+        },
+        [&](const sync_world_command&) {
+            sand::sync_world_file(pixels);
+        },
+        [&](const key_command& c) {
+            if (c.pressed) {
+                d_keyboard.on_event(make_event<keyboard_pressed_event>(c.key, 0, 0));
+            } else {
+                d_keyboard.on_event(make_event<keyboard_released_event>(c.key, 0, 0));
+            }
+        },
+        [&](const view_command& c) {
+            d_view = c.view;
+        },
+        [&](const budget_command& c) {
+            d_budget = c.budget;
+        },
+        [&](const record_command& c) {
+            // Restarting the random numbers from a known seed is what lets the session
+            // be replayed, everything else that happens from here on is recorded
+            const auto seed = (std::uint64_t{std::random_device{}()} << 32) | std::random_device{}();
+            const auto player = d_physics->player.get_state();
+            const auto keys = d_keyboard.get_state();
+            d_recorder = session_recorder::create(c.filename, pixels, player, keys, d_view, seed, *d_jobs);
+            if (d_recorder) {
+                sand::seed_random(seed);
+
+                // Start from a newly built physics scene, as a replay does
+                d_physics = std::make_unique<physics_scene>();
+                d_physics->player.set_state(player);
+
+                // A replay starts with no history, so undo must not reach back past here
+                d_history.clear();
+            }
+        },
+        [&](const stop_recording_command&) {
+            d_recorder.reset();
+        },
+        [&](const video_command& c) {
+            d_video = video_recorder::create(c.filename, pixels);
+        },
+        [&](const stop_video_command&) {
+            d_video.reset();
+        },
+        [&](const begin_edit_command&) {
+            d_history.begin();
+        },
+        [&](const undo_command&) {
+            d_history.undo(pixels);
+        },
+        [&](const redo_command&) {
+            d_history.redo(pixels);
+        }
+    }, cmd);
+}
+
+auto simulation::tick() -> void
+{
+    sand::schedule_chunks(*d_world, d_view, physics_to_pixel(d_physics->player.pos_physics()));
+
+    // The budget depends on how long updates take, so it is ignored while recording to
+    // keep the session deterministic
+    if (d_budget > std::chrono::nanoseconds::zero() && !d_recorder) {
+        sand::update(*d_world, *d_jobs, d_budget);
+    } else {
+        sand::update(*d_world, *d_jobs);
+    }
+    d_physics->player.update(d_keyboard);
+    d_physics->world.Step(sand::config::time_step, 8, 3);
+
+    // Key presses last for exactly one tick, however many frames that spans
+    d_keyboard.on_new_frame();
+
+    if (d_recorder) {
+        d_recorder->end_tick(*d_world, *d_jobs);
+    }
+    if (d_video) {
+        d_video->capture(*d_world, *d_jobs);
+    }
+}
+
+auto simulation::publish(std::uint32_t tick_rate) -> void
+{
+    // The back snapshot may be a few ticks old, bring across only what has changed
+    auto& next = d_snapshots.back();
+    next.pixels.sync_from(*d_world, *d_jobs);
+    next.player = to_snapshot(d_physics->player, glm::vec3{0.0, 1.0, 0.0});
+    next.bodies.clear();
+    for (const auto& body : d_physics->bodies) {
+        next.bodies.push_back(to_snapshot(body, body.colour()));
+    }
+    next.tick_rate = tick_rate;
+    next.file_backed = d_world->storage().file() != nullptr;
+    next.recording = d_recorder != nullptr;
+    next.recording_video = d_video != nullptr;
+    next.can_undo = d_history.can_undo();
+    next.can_redo = d_history.can_redo();
+    d_snapshots.publish();
+}
+
+}
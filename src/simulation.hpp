@@ -0,0 +1,283 @@
+#pragma once
+#include "world.hpp"
+#include "pixel.hpp"
+#include "explosion.hpp"
+#include "mouse.hpp"
+#include "player.hpp"
+#include "triple_buffer.hpp"
+#include "job_system.hpp"
+#include "level_of_detail.hpp"
+#include "history.hpp"
+#include "stamp.hpp"
+
+#include <glm/glm.hpp>
+#include <box2d/box2d.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+namespace sand {
+
+// Commands are how the rest of the application changes the simulation. They are
+// queued up and applied by the simulation thread at the start of its next tick.
+struct spray_command
+{
+    glm::ivec2 centre;
+    float      radius;
+    pixel_type type;
+};
+
+struct square_command
+{
+    glm::ivec2 centre;
+    int        half_extent;
+    pixel_type type;
+};
+
+struct circle_command
+{
+    glm::ivec2 centre;
+    float      radius;
+    pixel_type type;
+};
+
+// Fills the region connected to centre that is the same material as it
+struct flood_fill_command
+{
+    glm::ivec2 centre;
+    pixel_type type;
+};
+
+// Within the square, changes the material under centre to type
+struct replace_command
+{
+    glm::ivec2 centre;
+    int        half_extent;
+    pixel_type type;
+};
+
+// Pastes a copied region with its top left corner at top_left. Shared so the clipboard
+// can be pasted again without copying it.
+struct paste_command
+{
+    glm::ivec2                          top_left;
+    std::shared_ptr<const region_stamp> stamp;
+};
+
+struct explosion_command
+{
+    glm::ivec2 centre;
+    explosion  info;
+};
+
+struct clear_command {};
+
+// A world loaded off the simulation thread, swapped in at the start of the next tick
+struct replace_world_command
+{
+    std::unique_ptr<world> pixels;
+};
+
+struct key_command
+{
+    int  key;
+    bool pressed;
+};
+
+// Switches the world to being backed by the given world file, opening it if it exists
+// and otherwise creating it from the current world
+struct map_world_command
+{
+    std::string filename;
+};
+
+// Flushes the changes to a file backed world to disk
+struct sync_world_command {};
+
+// Brush strokes made after this are undone together, up to the next one. Explosions,
+// clearing and loading are always undone on their own.
+struct begin_edit_command {};
+
+struct undo_command {};
+struct redo_command {};
+
+// Starts recording a session to the given file, see session_recorder
+struct record_command
+{
+    std::string filename;
+};
+
+struct stop_recording_command {};
+
+// Starts recording what the world looks like each tick to the given file, see video_recorder
+struct video_command
+{
+    std::string filename;
+};
+
+struct stop_video_command {};
+
+// Limits the time spent updating chunks each tick, zero for no limit
+struct budget_command
+{
+    std::chrono::nanoseconds budget;
+};
+
+// Chunks are updated less often the further they are from the viewport
+struct view_command
+{
+    viewport view;
+};
+
+using command = std::variant<
+    spray_command,
+    square_command,
+    explosion_command,
+    clear_command,
+    replace_world_command,
+    map_world_command,
+    sync_world_command,
+    key_command,
+    view_command,
+    budget_command,
+    record_command,
+    stop_recording_command,
+    video_command,
+    stop_video_command,
+    begin_edit_command,
+    undo_command,
+    redo_command,
+    circle_command,
+    flood_fill_command,
+    replace_command,
+    paste_command
+>;
+
+struct body_snapshot
+{
+    glm::vec4 rect;
+    float     angle;
+    glm::vec3 colour;
+};
+
+// An immutable copy of the simulation state after a tick, for rendering and the UI
+struct snapshot
+{
+    world                      pixels;
+    body_snapshot              player = {};
+    std::vector<body_snapshot> bodies;
+    std::uint32_t              tick_rate = 0;
+    bool                       file_backed     = false;
+    bool                       recording       = false;
+    bool                       recording_video = false;
+    bool                       can_undo        = false;
+    bool                       can_redo        = false;
+};
+
+class static_physics_box
+{
+    int       d_width;
+    int       d_height;
+    glm::vec3 d_colour;
+    b2Body*   d_body = nullptr;
+
+public:
+    static_physics_box(b2World& world, glm::vec2 pos, int width, int height, glm::vec3 colour, float angle = 0.0f);
+
+    auto rect_pixels() const -> glm::vec4;
+    auto angle() const -> float;
+    auto colour() const -> glm::vec3 { return d_colour; }
+};
+
+// The physics world and the bodies in it. Box2D keeps contacts and other state that
+// can't be saved, so a recorded session starts from a newly built scene with the
+// player put back where it was, and a replay builds the same scene to start from.
+struct physics_scene
+{
+    b2World                         world;
+    player_controller               player;
+    std::vector<static_physics_box> bodies;
+
+    physics_scene();
+
+    physics_scene(const physics_scene&) = delete;
+    physics_scene& operator=(const physics_scene&) = delete;
+};
+
+class session_recorder;
+class video_recorder;
+
+enum class run_mode
+{
+    threaded, // Ticks at a fixed rate on its own thread
+    manual,   // Ticks only when step is called, on the calling thread
+};
+
+// Owns the world, the physics and the player and steps them at a fixed rate on its
+// own thread, handing the parallel parts of a tick to the job system. After each
+// tick the state is published as a snapshot, which the render thread picks up
+// without locking, so a slow tick never stalls a frame.
+class simulation
+{
+    job_system*                     d_jobs;
+    std::unique_ptr<world>          d_world;
+    std::unique_ptr<physics_scene>  d_physics;
+    keyboard                        d_keyboard;
+    viewport                        d_view;
+    std::chrono::nanoseconds        d_budget = {};
+    edit_history                    d_history;
+
+    std::unique_ptr<session_recorder> d_recorder;
+    std::unique_ptr<video_recorder>   d_video;
+
+    std::mutex           d_commands_mutex;
+    std::vector<command> d_commands;
+
+    triple_buffer<snapshot> d_snapshots;
+
+    // Runs the ticks, stopped first on destruction as it uses the world and the recorders
+    std::jthread d_thread;
+
+    auto run(std::stop_token token) -> void;
+    auto apply_all(std::vector<command>& commands) -> void;
+    auto apply(command& cmd) -> void;
+    auto tick() -> void;
+    auto publish(std::uint32_t tick_rate) -> void;
+
+    simulation(const simulation&) = delete;
+    simulation& operator=(const simulation&) = delete;
+
+public:
+    explicit simulation(job_system& jobs, run_mode mode = run_mode::threaded);
+    ~simulation();
+
+    // Thread safe, the command is applied at the start of the next tick
+    auto push(command cmd) -> void;
+
+    // Render thread only. Returns true if a newer snapshot than the last was acquired
+    auto acquire_snapshot() -> bool { return d_snapshots.acquire(); }
+    auto latest() const -> const snapshot& { return d_snapshots.front(); }
+
+    // Manual mode only. Applies the queued commands and runs one tick
+    auto step() -> void;
+    auto current_world() const -> const world& { return *d_world; }
+
+    // Manual mode only. Puts the simulation back in the state a recorded session
+    // started from, including the world tick, which chunk scheduling depends on,
+    // and the held keys. The physics scene is rebuilt as it was when recording began.
+    auto restore(
+        world&& pixels,
+        std::uint64_t tick,
+        const player_state& player,
+        const keyboard_state& keys,
+        const viewport& view
+    ) -> void;
+};
+
+}
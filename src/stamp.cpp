@@ -0,0 +1,268 @@
+#include "stamp.hpp"
+#include "binary_io.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <print>
+#include <span>
+#include <utility>
+
+namespace sand {
+namespace {
+
+static constexpr std::uint32_t stamp_magic = four_cc("SSTP");
+static constexpr std::uint32_t stamp_version = 1;
+
+static constexpr int max_stamp_extent = 4096;
+
+static constexpr auto stamp_extension = ".stamp";
+
+using bytes = std::vector<std::uint8_t>;
+
+// Runs of three or more of one value are stored as that value and a count, everything
+// else as literal spans, so the noise in the shades costs at most a byte per 128 pixels
+// rather than doubling its size. A header byte below 128 is followed by that many plus
+// one literals, otherwise by one value repeated header - 125 times.
+static constexpr std::size_t min_run = 3;
+static constexpr std::size_t max_run = 130;
+static constexpr std::size_t max_literals = 128;
+
+auto run_length(std::span<const std::uint8_t> in, std::size_t i) -> std::size_t
+{
+    auto run = std::size_t{1};
+    while (i + run != in.size() && run != max_run && in[i + run] == in[i]) ++run;
+    return run;
+}
+
+auto encode_plane(std::span<const std::uint8_t> in, bytes& out) -> void
+{
+    for (std::size_t i = 0; i != in.size();) {
+        if (const auto run = run_length(in, i); run >= min_run) {
+            out.push_back(static_cast<std::uint8_t>(run + 125));
+            out.push_back(in[i]);
+            i += run;
+            continue;
+        }
+        auto end = i + 1;
+        while (end != in.size() && end - i != max_literals && run_length(in, end) < min_run) ++end;
+        out.push_back(static_cast<std::uint8_t>(end - i - 1));
+        out.insert(out.end(), in.begin() + i, in.begin() + end);
+        i = end;
+    }
+}
+
+// Returns false unless in decodes to exactly the size of plane
+auto decode_plane(std::span<const std::uint8_t> in, std::span<std::uint8_t> plane) -> bool
+{
+    auto pos = std::size_t{0};
+    for (std::size_t i = 0; i != plane.size();) {
+        if (pos == in.size()) return false;
+        const auto header = std::size_t{in[pos++]};
+        if (header < max_literals) {
+            const auto count = header + 1;
+            if (count > in.size() - pos || count > plane.size() - i) return false;
+            std::copy_n(in.begin() + pos, count, plane.begin() + i);
+            pos += count;
+            i += count;
+        } else {
+            const auto count = header - 125;
+            if (pos == in.size() || count > plane.size() - i) return false;
+            std::fill_n(plane.begin() + i, count, in[pos++]);
+            i += count;
+        }
+    }
+    return pos == in.size();
+}
+
+// Names become file names in the library directory, so they must be a plain stem that
+// can't reach outside it
+auto valid_stamp_name(const std::string& name) -> bool
+{
+    if (name.empty() || name == "." || name == "..") return false;
+    if (name.find_first_of("/\\:") != std::string::npos) return false;
+    return std::filesystem::path{name}.filename() == name;
+}
+
+auto area(glm::ivec2 size) -> std::size_t
+{
+    return static_cast<std::size_t>(size.x) * static_cast<std::size_t>(size.y);
+}
+
+// Decodes both planes, checking the types are ones that exist
+auto decode_planes(const region_stamp& stamp, bytes& types, bytes& shades) -> bool
+{
+    types.resize(area(stamp.size));
+    shades.resize(area(stamp.size));
+    return decode_plane(stamp.types, types)
+        && decode_plane(stamp.shades, shades)
+        && std::ranges::all_of(types, [](std::uint8_t type) { return type < num_pixel_types; });
+}
+
+}
+
+auto copy_stamp(const world& pixels, glm::ivec2 corner, glm::ivec2 opposite) -> region_stamp
+{
+    const auto first = glm::max(glm::min(corner, opposite), glm::ivec2{0, 0});
+    const auto last = glm::min(glm::max(corner, opposite), glm::ivec2{pixels.width(), pixels.height()} - 1);
+
+    auto stamp = region_stamp{};
+    if (first.x > last.x || first.y > last.y) {
+        return stamp;
+    }
+    stamp.size = last - first + 1;
+
+    auto types = bytes{};
+    auto shades = bytes{};
+    types.reserve(area(stamp.size));
+    shades.reserve(area(stamp.size));
+    for (int y = first.y; y <= last.y; ++y) {
+        for (int x = first.x; x <= last.x; ++x) {
+            const auto& px = pixels.at({x, y});
+            types.push_back(static_cast<std::uint8_t>(px.type));
+            shades.push_back(px.shade);
+        }
+    }
+    encode_plane(types, stamp.types);
+    encode_plane(shades, stamp.shades);
+    return stamp;
+}
+
+auto decode_stamp(const region_stamp& stamp) -> std::vector<pixel>
+{
+    auto types = bytes{};
+    auto shades = bytes{};
+    if (stamp.empty() || !decode_planes(stamp, types, shades)) {
+        return {};
+    }
+
+    // Pixels are made a run of one type at a time so the colour noise is drawn in bulk,
+    // the colour is then replaced by the one copied
+    auto out = std::vector<pixel>(types.size());
+    for (std::size_t i = 0; i != types.size();) {
+        const auto type = static_cast<pixel_type>(types[i]);
+        auto end = i + 1;
+        while (end != types.size() && types[end] == types[i]) ++end;
+        make_pixels(type, std::span{out}.subspan(i, end - i));
+        for (; i != end; ++i) {
+            out[i].colour = from_shade(type, shades[i]);
+            out[i].shade = shades[i];
+        }
+    }
+    return out;
+}
+
+auto valid_stamp_size(glm::ivec2 size) -> bool
+{
+    return 0 < size.x && size.x <= max_stamp_extent && 0 < size.y && size.y <= max_stamp_extent;
+}
+
+auto max_plane_size(glm::ivec2 size) -> std::size_t
+{
+    // At worst every pixel is a literal with a header byte of its own
+    return 2 * area(size);
+}
+
+auto save_stamp(const region_stamp& stamp, const std::filesystem::path& filename) -> bool
+{
+    auto file = std::ofstream{filename, std::ios::binary};
+    if (!file) {
+        std::print("could not save stamp to {}\n", filename.string());
+        return false;
+    }
+    write(file, stamp_magic);
+    write(file, stamp_version);
+    write(file, static_cast<std::int32_t>(stamp.size.x));
+    write(file, static_cast<std::int32_t>(stamp.size.y));
+    write(file, static_cast<std::uint32_t>(stamp.types.size()));
+    write(file, static_cast<std::uint32_t>(stamp.shades.size()));
+    write_bytes(file, stamp.types);
+    write_bytes(file, stamp.shades);
+    return static_cast<bool>(file);
+}
+
+auto load_stamp(const std::filesystem::path& filename) -> std::unique_ptr<region_stamp>
+{
+    auto file = std::ifstream{filename, std::ios::binary};
+    if (!file) {
+        std::print("could not open stamp {}\n", filename.string());
+        return nullptr;
+    }
+
+    auto magic = std::uint32_t{0};
+    auto version = std::uint32_t{0};
+    auto width = std::int32_t{0};
+    auto height = std::int32_t{0};
+    auto types_size = std::uint32_t{0};
+    auto shades_size = std::uint32_t{0};
+    if (!read(file, magic) || magic != stamp_magic || !read(file, version) || version != stamp_version) {
+        std::print("{} is not a stamp\n", filename.string());
+        return nullptr;
+    }
+    if (!read(file, width) || !read(file, height) || !read(file, types_size) || !read(file, shades_size)
+        || !valid_stamp_size({width, height})
+        || types_size > max_plane_size({width, height}) || shades_size > max_plane_size({width, height})) {
+        std::print("stamp {} is corrupt\n", filename.string());
+        return nullptr;
+    }
+
+    auto stamp = std::make_unique<region_stamp>();
+    stamp->size = {width, height};
+    stamp->types.resize(types_size);
+    stamp->shades.resize(shades_size);
+
+    auto types = bytes{};
+    auto shades = bytes{};
+    if (!read_bytes(file, stamp->types) || !read_bytes(file, stamp->shades) || !decode_planes(*stamp, types, shades)) {
+        std::print("stamp {} is corrupt\n", filename.string());
+        return nullptr;
+    }
+    return stamp;
+}
+
+stamp_library::stamp_library(std::filesystem::path directory)
+    : d_directory{std::move(directory)}
+{
+    refresh();
+}
+
+auto stamp_library::refresh() -> void
+{
+    d_names.clear();
+    auto error = std::error_code{};
+    for (const auto& entry : std::filesystem::directory_iterator{d_directory, error}) {
+        if (entry.is_regular_file(error) && entry.path().extension() == stamp_extension) {
+            d_names.push_back(entry.path().stem().string());
+        }
+    }
+    std::ranges::sort(d_names);
+}
+
+auto stamp_library::save(const std::string& name, const region_stamp& stamp) -> bool
+{
+    if (!valid_stamp_name(name)) {
+        std::print("'{}' is not a valid stamp name\n", name);
+        return false;
+    }
+    auto error = std::error_code{};
+    std::filesystem::create_directories(d_directory, error);
+    if (error) {
+        std::print("could not create the stamp directory {}\n", d_directory.string());
+        return false;
+    }
+    if (!save_stamp(stamp, d_directory / (name + stamp_extension))) {
+        return false;
+    }
+    refresh();
+    return true;
+}
+
+auto stamp_library::load(const std::string& name) const -> std::unique_ptr<region_stamp>
+{
+    if (!valid_stamp_name(name)) {
+        std::print("'{}' is not a valid stamp name\n", name);
+        return nullptr;
+    }
+    return load_stamp(d_directory / (name + stamp_extension));
+}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "world.hpp"
+#include "pixel.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sand {
+
+// A rectangle of the world kept as what it looks like, the type and shade of each pixel,
+// with each plane run length encoded in row-major order. Velocities, flags and power are
+// not kept, so pasted pixels start out as if freshly placed.
+struct region_stamp
+{
+    glm::ivec2                size = {0, 0};
+    std::vector<std::uint8_t> types;
+    std::vector<std::uint8_t> shades;
+
+    auto empty() const -> bool { return size.x <= 0 || size.y <= 0; }
+};
+
+// Copies the rectangle between the two corners, inclusive and in any order, clipped to the world
+auto copy_stamp(const world& pixels, glm::ivec2 corner, glm::ivec2 opposite) -> region_stamp;
+
+// The pixels of the stamp in row-major order. Returns an empty vector if the planes don't
+// decode to exactly the stamp's size.
+auto decode_stamp(const region_stamp& stamp) -> std::vector<pixel>;
+
+// Whether a stamp this size can be loaded. Stamps are kept small on the assumption they
+// are parts of a scene rather than all of it.
+auto valid_stamp_size(glm::ivec2 size) -> bool;
+
+// The most bytes a plane of a stamp this size can encode to, for checking sizes read
+// from a file before allocating for them
+auto max_plane_size(glm::ivec2 size) -> std::size_t;
+
+auto save_stamp(const region_stamp& stamp, const std::filesystem::path& filename) -> bool;
+auto load_stamp(const std::filesystem::path& filename) -> std::unique_ptr<region_stamp>;
+
+// A directory of stamps saved by name, for building scenes out of reusable parts
+class stamp_library
+{
+    std::filesystem::path    d_directory;
+    std::vector<std::string> d_names;
+
+public:
+    explicit stamp_library(std::filesystem::path directory);
+
+    // Rescans the directory, the names are kept sorted
+    auto refresh() -> void;
+    auto names() const -> const std::vector<std::string>& { return d_names; }
+
+    // Names must be a plain file name stem, without directories or separators
+    auto save(const std::string& name, const region_stamp& stamp) -> bool;
+    auto load(const std::string& name) const -> std::unique_ptr<region_stamp>;
+};
+
+}
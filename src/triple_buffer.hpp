@@ -0,0 +1,51 @@
+#pragma once
+#include <array>
+#include <atomic>
+
+namespace sand {
+
+// Hands values from one writer thread to one reader thread without locking. The
+// writer fills back() and publishes it; the reader acquires the most recently
+// published value and reads it through front() for as long as it likes. Neither
+// side ever waits for the other, values the reader was too slow to see are
+// simply overwritten.
+template <typename T>
+class triple_buffer
+{
+    static constexpr int index_mask = 0b011;
+    static constexpr int fresh_bit  = 0b100;
+
+    std::array<T, 3> d_slots;
+    int              d_back   = 0;
+    int              d_front  = 1;
+    std::atomic<int> d_middle = 2;
+
+    triple_buffer(const triple_buffer&) = delete;
+    triple_buffer& operator=(const triple_buffer&) = delete;
+
+public:
+    triple_buffer() = default;
+
+    // Writer side. The back slot holds whatever was last written to it, which may
+    // be several publishes old
+    auto back() -> T& { return d_slots[d_back]; }
+
+    auto publish() -> void
+    {
+        d_back = d_middle.exchange(d_back | fresh_bit, std::memory_order_acq_rel) & index_mask;
+    }
+
+    // Reader side. Returns true if a new value was published since the last call
+    auto acquire() -> bool
+    {
+        if (!(d_middle.load(std::memory_order_relaxed) & fresh_bit)) {
+            return false;
+        }
+        d_front = d_middle.exchange(d_front, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+
+    auto front() const -> const T& { return d_slots[d_front]; }
+};
+
+}
@@ -2,9 +2,13 @@
 #include "utility.hpp"
 #include "config.hpp"
 #include "explosion.hpp"
+#include "reaction.hpp"
 #include "world.hpp"
+#include "job_system.hpp"
 
 #include <array>
+#include <chrono>
+#include <tuple>
 #include <utility>
 #include <variant>
 #include <algorithm>
@@ -35,7 +39,7 @@ static constexpr auto adjacent_offsets = std::array{
     glm::ivec2{0, -1}
 };
 
-auto can_pixel_move_to(const world& pixels, glm::ivec2 src_pos, glm::ivec2 dst_pos) -> bool
+auto can_pixel_move_to(const auto& pixels, glm::ivec2 src_pos, glm::ivec2 dst_pos) -> bool
 {
     if (!pixels.valid(src_pos) || !pixels.valid(dst_pos)) { return false; }
 
@@ -59,7 +63,7 @@ auto can_pixel_move_to(const world& pixels, glm::ivec2 src_pos, glm::ivec2 dst_p
     }
 }
 
-auto set_adjacent_free_falling(world& pixels, glm::ivec2 pos) -> void
+auto set_adjacent_free_falling(auto& pixels, glm::ivec2 pos) -> void
 {
     const auto l = pos + glm::ivec2{-1, 0};
     const auto r = pos + glm::ivec2{1, 0};
@@ -70,7 +74,7 @@ auto set_adjacent_free_falling(world& pixels, glm::ivec2 pos) -> void
             const auto& props = properties(px);
             if (props.gravity_factor != 0.0f) {
                 pixels.wake_chunk_with_pixel(l);
-                if (random_unit() > props.inertial_resistance) px.flags[is_falling] = true;
+                if (roll(chances(px).start_falling)) px.flags[is_falling] = true;
             }
         }
     }
@@ -78,7 +82,7 @@ auto set_adjacent_free_falling(world& pixels, glm::ivec2 pos) -> void
 
 // Moves towards the given offset, updating pos to the new postion and returning
 // true if the position has changed
-auto move_offset(world& pixels, glm::ivec2& pos, glm::ivec2 offset) -> bool
+auto move_offset(auto& pixels, glm::ivec2& pos, glm::ivec2 offset) -> bool
 {
     glm::ivec2 start_pos = pos;
 
@@ -106,7 +110,7 @@ auto move_offset(world& pixels, glm::ivec2& pos, glm::ivec2 offset) -> bool
     return false;
 }
 
-auto is_surrounded(const world& pixels, glm::ivec2 pos) -> bool
+auto is_surrounded(const auto& pixels, glm::ivec2 pos) -> bool
 { 
     for (const auto& offset : neighbour_offsets) {
         if (pixels.valid(pos + offset)) {
@@ -118,43 +122,48 @@ auto is_surrounded(const world& pixels, glm::ivec2 pos) -> bool
     return true;
 }
 
-auto sign(float f) -> int
+constexpr auto sign(float f) -> int
 {
     if (f < 0.0f) return -1;
     if (f > 0.0f) return 1;
     return 0;
 }
 
-inline auto update_pixel_position(world& pixels, glm::ivec2& pos) -> void
+// Chunks updated less often than every tick pass the number of ticks being covered as
+// steps. Falling and dispersing cover that many ticks worth of distance to keep pace,
+// and burning and reactions get that many rolls so they happen at the same rate.
+template <pixel_type Type>
+inline auto update_pixel_position(auto& pixels, glm::ivec2& pos, int steps) -> void
 {
+    static constexpr auto props = properties(Type);
     const auto start_pos = pos;
 
     auto& data = pixels.at(pos);
-    const auto& props = properties(data);
 
     // Pixels that don't move have their is_falling flag set to false at the end
     const auto after_position_update = scope_exit{[&] {
         pixels.at(pos).flags[is_falling] = pos != start_pos;
-        if (pos == start_pos && properties(pixels.at(pos)).gravity_factor) {
-            pixels.at(pos).velocity = glm::ivec2{0, 1}; // will always try to move at least one block
+        if constexpr (props.gravity_factor != 0.0f) {
+            if (pos == start_pos) {
+                pixels.at(pos).velocity = glm::ivec2{0, 1}; // will always try to move at least one block
+            }
         }
     }};
 
     // Apply gravity
-    if (props.gravity_factor) {
-        const auto gravity_factor = props.gravity_factor;
-        data.velocity += gravity_factor * config::gravity * config::time_step;
-        if (move_offset(pixels, pos, data.velocity)) return;
+    if constexpr (props.gravity_factor != 0.0f) {
+        data.velocity += props.gravity_factor * config::gravity * config::time_step * static_cast<float>(steps);
+        if (move_offset(pixels, pos, data.velocity * static_cast<float>(steps))) return;
     }
 
     // If we have resistance to moving and we are not, then we are not moving
-    if (props.inertial_resistance && !pixels.at(pos).flags[is_falling]) {
-        return;
+    if constexpr (props.inertial_resistance != 0.0f) {
+        if (!pixels.at(pos).flags[is_falling]) return;
     }
 
     // Attempts to move diagonally up/down
-    if (props.can_move_diagonally) {
-        const auto dir = sign(props.gravity_factor);
+    if constexpr (props.can_move_diagonally) {
+        static constexpr auto dir = sign(props.gravity_factor);
         auto offsets = std::array{glm::ivec2{-1, dir}, glm::ivec2{1, dir}};
         if (coin_flip()) std::swap(offsets[0], offsets[1]);
 
@@ -164,9 +173,8 @@ inline auto update_pixel_position(world& pixels, glm::ivec2& pos) -> void
     }
 
     // Attempts to disperse outwards according to the dispersion rate
-    if (props.dispersion_rate) {
-
-        const auto dr = props.dispersion_rate;
+    if constexpr (props.dispersion_rate != 0) {
+        const auto dr = props.dispersion_rate * steps;
         auto offsets = std::array{glm::ivec2{-dr, 0}, glm::ivec2{dr, 0}};
         if (coin_flip()) std::swap(offsets[0], offsets[1]);
 
@@ -178,7 +186,7 @@ inline auto update_pixel_position(world& pixels, glm::ivec2& pos) -> void
 
 // Determines if the pixel at the given offset should power the current position.
 // offset must be a unit vector.
-auto should_get_powered(const world& pixels, glm::ivec2 pos, glm::ivec2 offset) -> bool
+auto should_get_powered(const auto& pixels, glm::ivec2 pos, glm::ivec2 offset) -> bool
 {
     const auto& src = pixels.at(pos + offset);
     const auto& dst = pixels.at(pos);
@@ -212,174 +220,387 @@ auto should_get_powered(const world& pixels, glm::ivec2 pos, glm::ivec2 offset)
         || ((props.power_max) / 2 < src.power && src.power < props.power_max);
 }
 
-// Update logic for single pixels depending on properties only
-inline auto update_pixel_attributes(world& pixels, glm::ivec2 pos) -> void
+// Update logic for single pixels depending on properties only. Rolls against
+// probabilities that are zero for this material are compiled out. The chances are per
+// tick, so each is rolled for every one of the steps being covered.
+template <pixel_type Type>
+inline auto update_pixel_attributes(auto& pixels, glm::ivec2 pos, int steps) -> void
 {
+    static constexpr auto props = properties(Type);
+    static constexpr auto odds = chances(Type);
     auto& pixel = pixels.at(pos);
-    const auto& props = properties(pixel);
 
-    if (pixel.flags[is_burning] || props.always_awake) {
+    if constexpr (props.always_awake) {
         pixels.wake_chunk_with_pixel(pos);
+    } else {
+        if (pixel.flags[is_burning]) {
+            pixels.wake_chunk_with_pixel(pos);
+        }
     }
 
     // is_burning status
     if (pixel.flags[is_burning]) {
 
         // See if it can be put out
-        const auto put_out = is_surrounded(pixels, pos) ? props.put_out_surrounded : props.put_out;
-        if (random_unit() < put_out) {
-            pixel.flags[is_burning] = false;
+        if constexpr (props.put_out_surrounded != 0.0f || props.put_out != 0.0f) {
+            const auto chance = is_surrounded(pixels, pos) ? odds.put_out_surrounded : odds.put_out;
+            if (roll(chance, steps)) {
+                pixel.flags[is_burning] = false;
+            }
         }
 
         // See if it gets destroyed
-        if (random_unit() < props.burn_out_chance) {
-            pixel = pixel::air();
+        if constexpr (props.burn_out_chance != 0.0f) {
+            if (roll(odds.burn_out, steps)) {
+                pixels.set(pos, pixel::air());
+            }
         }
 
         // See if it explodes
-        if (random_unit() < props.explosion_chance) {
-            apply_explosion(pixels, pos, sand::explosion{
-                .min_radius = 5.0f, .max_radius = 10.0f, .scorch = 5.0f
-            });
+        if constexpr (props.explosion_chance != 0.0f) {
+            if (roll(odds.explode, steps)) {
+                apply_explosion(pixels, pos, sand::explosion{
+                    .min_radius = 5.0f, .max_radius = 10.0f, .scorch = 5.0f
+                });
+            }
         }
 
     }
 
     // Electricity
-    switch (props.power_type) {
-        case pixel_power_type::conductor: {
-            if (pixel.power > 0) {
-                --pixel.power;
-            }
+    if constexpr (props.power_type == pixel_power_type::conductor) {
+        if (pixel.power > 0) {
+            --pixel.power;
+        }
 
-            // Check to see if we should power up just before we hit zero in order to
-            // maintain a current
-            if (pixel.power <= 1) {
-                for (const auto& offset : adjacent_offsets) {
-                    if (!pixels.valid(pos + offset)) continue;
-                    auto& neighbour = pixels.at(pos + offset);
-
-                    if (should_get_powered(pixels, pos, offset)) {
-                        pixel.power = props.power_max;
-                        break;
-                    }
+        // Check to see if we should power up just before we hit zero in order to
+        // maintain a current
+        if (pixel.power <= 1) {
+            for (const auto& offset : adjacent_offsets) {
+                if (!pixels.valid(pos + offset)) continue;
+
+                if (should_get_powered(pixels, pos, offset)) {
+                    pixel.power = props.power_max;
+                    break;
                 }
             }
+        }
 
-            if (pixel.power > 0 && props.explodes_on_power) {
+        if constexpr (props.explodes_on_power) {
+            if (pixel.power > 0) {
                 apply_explosion(pixels, pos, sand::explosion{
                     .min_radius = 25.0f, .max_radius = 30.0f, .scorch = 10.0f
                 });
             }
-        } break;
-
-        case pixel_power_type::source: {
-            if (pixel.power < props.power_max) {
-                ++pixel.power;
+        }
+    }
+    else if constexpr (props.power_type == pixel_power_type::source) {
+        if (pixel.power < props.power_max) {
+            ++pixel.power;
+        }
+        for (const auto& offset : adjacent_offsets) {
+            if (!pixels.valid(pos + offset)) continue;
+            auto& neighbour = pixels.at(pos + offset);
+
+            // Powered diode_offs disable power sources
+            if (neighbour.type == pixel_type::diode_out && neighbour.power > 0) {
+                pixel.power = 0;
+                break;
             }
-            for (const auto& offset : adjacent_offsets) {
-                if (!pixels.valid(pos + offset)) continue;
-                auto& neighbour = pixels.at(pos + offset);
+        }
+    }
 
-                // Powered diode_offs disable power sources
-                if (neighbour.type == pixel_type::diode_out && neighbour.power > 0) {
-                    pixel.power = 0;
-                    break;
-                }
-            }
-        } break;
+    if constexpr (props.power_type != pixel_power_type::none) {
+        if (pixel.power > 0) {
+            pixels.wake_chunk_with_pixel(pos);
+        }
+    }
 
-        case pixel_power_type::none: {} break;
+    if constexpr (props.spontaneous_destroy != 0.0f) {
+        if (roll(odds.destroy, steps)) {
+            pixels.set(pos, pixel::air());
+        }
     }
+}
 
-    if (pixel.power > 0) {
-        pixels.wake_chunk_with_pixel(pos);
+// The chances in a reaction as thresholds to roll against
+struct reaction_chances
+{
+    probability happens;
+    probability consumes;
+};
+
+constexpr auto make_reaction_chances(const std::array<reaction, num_pixel_types>& row)
+{
+    auto out = std::array<reaction_chances, num_pixel_types>{};
+    for (std::size_t i = 0; i != num_pixel_types; ++i) {
+        out[i] = {probability{row[i].chance}, probability{row[i].consume_chance}};
     }
+    return out;
+}
+
+static constexpr auto burning_chances = make_reaction_chances(reactions.burning);
+
+auto apply_reaction(
+    auto& pixels, glm::ivec2 pos, glm::ivec2 neigh_pos, const reaction& r, const reaction_chances& odds, int steps
+) -> void
+{
+    if (!roll(odds.happens, steps)) return;
+
+    switch (r.action) {
+        case reaction_action::convert: {
+            pixels.set(neigh_pos, make_pixel(r.result));
+        } break;
+
+        case reaction_action::corrode: {
+            pixels.set(neigh_pos, pixel::air());
+            if (roll(odds.consumes)) {
+                pixels.set(pos, pixel::air());
+            }
+        } break;
+
+        case reaction_action::ignite: {
+            pixels.at(neigh_pos).flags[is_burning] = true;
+            pixels.wake_chunk_with_pixel(neigh_pos);
+        } break;
+
+        case reaction_action::emit: {
+            pixels.set(neigh_pos, make_pixel(r.result));
+        } break;
 
-    if (random_unit() < props.spontaneous_destroy) {
-        pixels.set(pos, pixel::air());
+        case reaction_action::none: {} break;
     }
 }
 
-inline auto update_pixel_neighbours(world& pixels, glm::ivec2 pos) -> void
+template <pixel_type Type>
+inline auto update_pixel_neighbours(auto& pixels, glm::ivec2 pos, int steps) -> void
 {
+    static constexpr auto type_index = static_cast<std::size_t>(Type);
+    static constexpr const auto& row = reactions.by_type[type_index];
+    static constexpr auto row_chances = make_reaction_chances(row);
     auto& pixel = pixels.at(pos);
-    const auto& props = properties(pixel);
+
+    // Inert materials only affect their neighbours while burning
+    if constexpr (!reactions.has_reactions[type_index]) {
+        if (!pixel.flags[is_burning]) return;
+    }
 
     // Affect adjacent neighbours as well as diagonals
     for (const auto& offset : neighbour_offsets) {
-        if (!pixels.valid(pos + offset)) continue;             
+        if (!pixels.valid(pos + offset)) continue;
         const auto neigh_pos = pos + offset;
-        auto& neighbour = pixels.at(neigh_pos);
+        const auto neigh_index = static_cast<std::size_t>(pixels.at(neigh_pos).type);
 
-        // Boil water
-        if (props.can_boil_water) {
-            if (neighbour.type == pixel_type::water) {
-                neighbour = pixel::steam();
-            }
+        const auto& r = row[neigh_index];
+        if (r.action != reaction_action::none) {
+            apply_reaction(pixels, pos, neigh_pos, r, row_chances[neigh_index], steps);
         }
-
-        // Corrode neighbours
-        if (props.is_corrosion_source) {
-            if (random_unit() > properties(neighbour).corrosion_resist) {
-                neighbour = pixel::air();
-                if (random_unit() > 0.9f) {
-                    pixel = pixel::air();
-                }
-            }
-        }
-        
-        // Spread fire
-        if (props.is_burn_source || pixel.flags[is_burning]) {
-            if (random_unit() < properties(neighbour).flammability) {
-                neighbour.flags[is_burning] = true;
-                pixels.wake_chunk_with_pixel(neigh_pos);
-            }
+        else if (pixel.flags[is_burning] && reactions.burning[neigh_index].action != reaction_action::none) {
+            apply_reaction(pixels, pos, neigh_pos, reactions.burning[neigh_index], burning_chances[neigh_index], steps);
         }
+    }
+}
 
-        // Produce embers
-        const bool can_produce_embers = props.is_ember_source || pixel.flags[is_burning];
-        if (can_produce_embers && neighbour.type == pixel_type::none) {
-            if (random_unit() < 0.01f) {
-                pixels.set(neigh_pos, pixel::ember());
-            }
+template <typename World>
+using stepped_kernel = auto(*)(World&, glm::ivec2, int) -> void;
+
+template <typename World, pixel_type Type>
+auto attributes_kernel(World& pixels, glm::ivec2 pos, int steps) -> void
+{
+    update_pixel_attributes<Type>(pixels, pos, steps);
+}
+
+template <typename World, std::size_t... Types>
+constexpr auto make_attributes_kernels(std::index_sequence<Types...>)
+{
+    return std::array<stepped_kernel<World>, sizeof...(Types)>{
+        &attributes_kernel<World, static_cast<pixel_type>(Types)>...
+    };
+}
+
+// Used when a pixel may have changed type part way through its update
+template <typename World>
+constexpr auto attributes_kernels = make_attributes_kernels<World>(std::make_index_sequence<num_pixel_types>{});
+
+template <typename World, pixel_type Type>
+auto update_kernel(World& pixels, glm::ivec2 pos, int steps) -> void
+{
+    static constexpr auto props = properties(Type);
+
+    if constexpr (Type != pixel_type::none) {
+        update_pixel_position<Type>(pixels, pos, steps);
+        update_pixel_neighbours<Type>(pixels, pos, steps);
+
+        // Corrosion sources can dissolve themselves when corroding their neighbours
+        if constexpr (props.is_corrosion_source) {
+            const auto type = pixels.at(pos).type;
+            attributes_kernels<World>[static_cast<std::size_t>(type)](pixels, pos, steps);
+        } else {
+            update_pixel_attributes<Type>(pixels, pos, steps);
         }
+
+        pixels.at(pos).flags[is_updated] = true;
     }
 }
 
-auto update_pixel(world& pixels, glm::ivec2 pos) -> void
+template <typename World, std::size_t... Types>
+constexpr auto make_update_kernels(std::index_sequence<Types...>)
+{
+    return std::array<stepped_kernel<World>, sizeof...(Types)>{
+        &update_kernel<World, static_cast<pixel_type>(Types)>...
+    };
+}
+
+// Each material gets its own update function with its behaviour resolved at compile time
+template <typename World>
+constexpr auto update_kernels = make_update_kernels<World>(std::make_index_sequence<num_pixel_types>{});
+
+// Materials that can change, or change their surroundings, when updated. A chunk made
+// up only of other materials has nothing to do, so the whole chunk is skipped.
+static constexpr auto dynamic_types = make_type_mask([](pixel_type type) {
+    const auto props = properties(type);
+    return props.gravity_factor != 0.0f
+        || props.can_move_diagonally
+        || props.dispersion_rate != 0
+        || props.always_awake
+        || props.spontaneous_destroy != 0.0f
+        || props.flammability != 0.0f
+        || props.power_type != pixel_power_type::none
+        || reactions.has_reactions[static_cast<std::size_t>(type)];
+});
+
+template <typename World>
+auto update_pixel(World& pixels, glm::ivec2 pos, int steps) -> void
 {
-    if (pixels.at(pos).type == pixel_type::none || pixels.at(pos).flags[is_updated]) {
+    const auto& pixel = pixels.at(pos);
+    if (pixel.flags[is_updated]) {
         return;
     }
 
-    update_pixel_position(pixels, pos);
-    update_pixel_neighbours(pixels, pos);
-    update_pixel_attributes(pixels, pos);
-
-    pixels.at(pos).flags[is_updated] = true;
+    update_kernels<World>[static_cast<std::size_t>(pixel.type)](pixels, pos, steps);
 }
 
-}
+// Chunks that have fallen far behind catch up over several updates rather than all
+// at once, as moving that far in one go looks like teleporting
+static constexpr int max_steps = 8;
 
-auto update(world& pixels) -> void
+template <typename World>
+auto is_runnable(const World& pixels, std::size_t index) -> bool
 {
-    pixels.new_frame();
+    const auto& chunk = pixels.get_chunks()[index];
+    return chunk.should_step && pixels.is_chunk_due(index) && chunk.contains_any(dynamic_types);
+}
 
-    for (int y = sand::config::num_pixels; y != 0; --y) {
+// Updates a whole chunk bottom to top, used when chunks are processed one at a time
+template <typename World>
+auto update_chunk(World& pixels, std::size_t index, int steps) -> void
+{
+    const auto chunk_size = pixels.chunk_size();
+    const auto top_left = chunk_size * pixels.get_chunk_pos(index);
+    for (int y = top_left.y + chunk_size; y != top_left.y; --y) {
         if (coin_flip()) {
-            for (int x = 0; x != sand::config::num_pixels; ++x) {
-                const auto pos = glm::ivec2{x, y - 1};
-                if (pixels.is_chunk_awake(pos)) update_pixel(pixels, pos);
+            for (int x = top_left.x; x != top_left.x + chunk_size; ++x) {
+                update_pixel(pixels, {x, y - 1}, steps);
             }
         }
         else {
-            for (int x = sand::config::num_pixels; x != 0; --x) {
-                const auto pos = glm::ivec2{x - 1, y - 1};
-                if (pixels.is_chunk_awake(pos)) update_pixel(pixels, pos);
+            for (int x = top_left.x + chunk_size; x != top_left.x; --x) {
+                update_pixel(pixels, {x - 1, y - 1}, steps);
+            }
+        }
+    }
+}
+
+}
+
+template <typename Geometry>
+auto update(basic_world<Geometry>& pixels, job_system& jobs) -> void
+{
+    pixels.new_frame(jobs);
+
+    // Work out the steps for every chunk before any are updated as updating a chunk
+    // clears what it is owed
+    auto& scratch = job_system::scratch();
+    const auto scope = scratch_scope{scratch};
+    const auto num_chunks = pixels.get_chunks().size();
+    auto steps = scratch.allocate<int>(num_chunks);
+    for (std::size_t index = 0; index != num_chunks; ++index) {
+        steps[index] = 0;
+        if (is_runnable(pixels, index)) {
+            steps[index] = pixels.take_pending_ticks(index, max_steps);
+        }
+    }
+
+    const auto chunk_size = pixels.chunk_size();
+    const auto chunks_wide = pixels.chunks_wide();
+    for (int y = pixels.height(); y != 0; --y) {
+        const auto left_to_right = coin_flip();
+        for (int c = 0; c != chunks_wide; ++c) {
+            const auto chunk_x = left_to_right ? c : chunks_wide - 1 - c;
+            const auto index = pixels.get_chunk_index({chunk_x, (y - 1) / chunk_size});
+            if (steps[index] == 0) continue;
+
+            const auto start = chunk_x * chunk_size;
+            if (left_to_right) {
+                for (int x = start; x != start + chunk_size; ++x) {
+                    update_pixel(pixels, {x, y - 1}, steps[index]);
+                }
+            }
+            else {
+                for (int x = start + chunk_size; x != start; --x) {
+                    update_pixel(pixels, {x - 1, y - 1}, steps[index]);
+                }
             }
         }
     }
 }
 
-}
\ No newline at end of file
+template <typename Geometry>
+auto update(basic_world<Geometry>& pixels, job_system& jobs, std::chrono::nanoseconds budget) -> void
+{
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+
+    pixels.new_frame(jobs);
+
+    auto& scratch = job_system::scratch();
+    const auto scope = scratch_scope{scratch};
+    const auto& chunks = pixels.get_chunks();
+    auto order = scratch.allocate<std::size_t>(chunks.size());
+    auto num_runnable = std::size_t{0};
+    for (std::size_t index = 0; index != chunks.size(); ++index) {
+        if (is_runnable(pixels, index)) {
+            order[num_runnable++] = index;
+        }
+    }
+
+    // Chunks on screen first, then the ones furthest behind so nothing starves, then
+    // bottom to top to match the order of a full update. Only awake chunks are run and
+    // a chunk is only awake if it changed last tick, so these are all recently changed.
+    const auto runnable = order.first(num_runnable);
+    std::ranges::sort(runnable, [&](std::size_t lhs, std::size_t rhs) {
+        const auto& l = chunks[lhs];
+        const auto& r = chunks[rhs];
+        const auto key = [&](const chunk& c, std::size_t index) {
+            return std::tuple{c.update_period != 1, -c.lag, -pixels.get_chunk_pos(index).y};
+        };
+        return key(l, lhs) < key(r, rhs);
+    });
+
+    // Always make progress on at least one chunk, whatever the budget
+    for (std::size_t i = 0; i != runnable.size(); ++i) {
+        const auto index = runnable[i];
+        if (i != 0 && clock::now() - start > budget) {
+            pixels.defer_chunk(index);
+            continue;
+        }
+        update_chunk(pixels, index, pixels.take_pending_ticks(index, max_steps));
+    }
+}
+
+template auto update(basic_world<sand::config::geometry>&, job_system&) -> void;
+template auto update(basic_world<dynamic_geometry>&, job_system&) -> void;
+template auto update(basic_world<sand::config::geometry>&, job_system&, std::chrono::nanoseconds) -> void;
+template auto update(basic_world<dynamic_geometry>&, job_system&, std::chrono::nanoseconds) -> void;
+
+}
@@ -1,8 +1,18 @@
 #pragma once
+#include <chrono>
 
 namespace sand {
 
-class world;
-auto update(world& pixel) -> void;
+template <typename Geometry> class basic_world;
+class job_system;
+
+template <typename Geometry>
+auto update(basic_world<Geometry>& pixels, job_system& jobs) -> void;
+
+// Updates chunks one at a time in priority order until the budget is spent. Chunks
+// that miss out stay awake and are owed the ticks they missed, which they catch up
+// on when they are next reached.
+template <typename Geometry>
+auto update(basic_world<Geometry>& pixels, job_system& jobs, std::chrono::nanoseconds budget) -> void;
     
-}
\ No newline at end of file
+}
@@ -2,8 +2,10 @@
 #include "camera.hpp"
 #include "graphics/window.hpp"
 
+#include <algorithm>
 #include <array>
 #include <random>
+#include <cmath>
 #include <numbers>
 #include <iostream>
 
@@ -40,22 +42,45 @@ auto timer::now() const -> clock::time_point
     return d_clock.now();
 }
 
+namespace {
+
+thread_local random_engine generator_state;
+
+// Bits of a random word not yet handed out by coin_flip
+thread_local std::uint32_t coin_bits      = 0;
+thread_local int           coin_remaining = 0;
+
+}
+
+auto generator() -> random_engine&
+{
+    return generator_state;
+}
+
+auto seed_random(std::uint64_t seed) -> void
+{
+    generator_state = random_engine{seed};
+    coin_remaining = 0;
+}
+
+auto random_word() -> std::uint32_t
+{
+    return generator()();
+}
+
 auto random_from_range(float min, float max) -> float
 {
-    static std::default_random_engine gen;
-    return std::uniform_real_distribution(min, max)(gen);
+    return std::uniform_real_distribution(min, max)(generator());
 }
 
 auto random_from_range(int min, int max) -> int
 {
-    static std::default_random_engine gen;
-    return std::uniform_int_distribution(min, max)(gen);
+    return std::uniform_int_distribution(min, max)(generator());
 }
 
 auto random_normal(float centre, float sd) -> float
 {
-    static std::default_random_engine gen;
-    return std::normal_distribution(centre, sd)(gen);
+    return std::normal_distribution(centre, sd)(generator());
 }
 
 auto random_from_circle(float radius) -> glm::ivec2
@@ -65,9 +90,17 @@ auto random_from_circle(float radius) -> glm::ivec2
     return { r * std::cos(x), r * std::sin(x) };
 }
 
+// Hands out the bits of a random word one at a time
 auto coin_flip() -> bool
 {
-    return random_from_range(0, 1) == 0;
+    if (coin_remaining == 0) {
+        coin_bits = random_word();
+        coin_remaining = 32;
+    }
+    const auto result = coin_bits & 1u;
+    coin_bits >>= 1;
+    --coin_remaining;
+    return result;
 }
 
 auto sign_flip() -> int
@@ -77,7 +110,7 @@ auto sign_flip() -> int
 
 auto random_unit() -> float
 {
-    return random_from_range(0.0f, 1.0f);
+    return static_cast<float>(random_word() >> 8) * 0x1p-24f;
 }
 
 auto _print_inner(const std::string& msg) -> void
@@ -1,6 +1,8 @@
 #pragma once
 #include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <string>
 #include <span>
 #include <format>
@@ -59,6 +61,75 @@ public:
     auto now() const -> clock::time_point;
 };
 
+// Small, fast generator of uniformly random 32-bit words (PCG-XSH-RR). Satisfies
+// UniformRandomBitGenerator so it can drive the std distributions.
+class random_engine
+{
+    std::uint64_t d_state     = 0x853c49e6748fea9bULL;
+    std::uint64_t d_increment = 0xda3e39cb94b95bdbULL;
+
+public:
+    using result_type = std::uint32_t;
+
+    random_engine() = default;
+    explicit random_engine(std::uint64_t seed)
+    {
+        d_state = seed + d_increment;
+        (*this)();
+    }
+
+    static constexpr auto min() -> result_type { return 0; }
+    static constexpr auto max() -> result_type { return std::numeric_limits<result_type>::max(); }
+
+    auto operator()() -> result_type
+    {
+        const auto old = d_state;
+        d_state = old * 6364136223846793005ULL + d_increment;
+        const auto xorshifted = static_cast<std::uint32_t>(((old >> 18u) ^ old) >> 27u);
+        const auto rot = static_cast<std::uint32_t>(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+    }
+};
+
+// A probability stored as a threshold to compare a random 32-bit word against, so
+// that checking it is a single integer comparison. The threshold is 64-bit so that a
+// probability of 1 can be above every word and always succeed.
+struct probability
+{
+    std::uint64_t threshold = 0;
+
+    constexpr probability() = default;
+    constexpr explicit probability(float p)
+        : threshold{
+            p <= 0.0f ? 0u :
+            p >= 1.0f ? std::uint64_t{1} << 32 :
+            static_cast<std::uint64_t>(static_cast<double>(p) * 4294967296.0)
+        }
+    {}
+};
+
+auto random_word() -> std::uint32_t;
+
+// Restarts the calling thread's random numbers from the given seed, so that what follows
+// is reproducible
+auto seed_random(std::uint64_t seed) -> void;
+
+// True with the given probability
+inline auto roll(probability p) -> bool
+{
+    return std::uint64_t{random_word()} < p.threshold;
+}
+
+// True if any of the given number of independent rolls succeeds, for chances per tick
+// checked once to cover several ticks
+inline auto roll(probability p, int trials) -> bool
+{
+    for (int i = 0; i != trials; ++i) {
+        if (roll(p)) return true;
+    }
+    return false;
+}
+
 auto random_from_range(float min, float max) -> float;
 auto random_from_range(int min, int max) -> int;
 auto random_from_circle(float radius) -> glm::ivec2;
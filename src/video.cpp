@@ -0,0 +1,394 @@
+#include "video.hpp"
+#include "pixel.hpp"
+#include "binary_io.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <print>
+#include <span>
+#include <utility>
+
+namespace sand {
+namespace {
+
+static constexpr std::uint32_t video_magic = four_cc("SVID");
+static constexpr std::uint32_t video_version = 1;
+
+// Two seconds of frames at the tick rate
+static constexpr std::size_t max_queued_frames = 120;
+
+// Magic, version, width, height, chunk size and keyframe interval
+static constexpr std::streamoff video_header_size = 6 * 4;
+
+using bytes = std::vector<std::uint8_t>;
+
+// Each plane is stored as its difference from the previous frame, so unchanged cells are
+// zero and collapse into a few long runs. Runs are (value, length) with length up to 255.
+auto encode_plane(std::span<const std::uint8_t> current, std::span<std::uint8_t> previous, bytes& out) -> bool
+{
+    auto changed = false;
+    for (std::size_t i = 0; i != current.size();) {
+        const auto value = static_cast<std::uint8_t>(current[i] ^ previous[i]);
+        auto run = std::size_t{1};
+        while (i + run != current.size() && run != 255 && (current[i + run] ^ previous[i + run]) == value) {
+            ++run;
+        }
+        out.push_back(value);
+        out.push_back(static_cast<std::uint8_t>(run));
+        changed |= value != 0;
+        i += run;
+    }
+    std::ranges::copy(current, previous.begin());
+    return changed;
+}
+
+// Returns the number of bytes read from in, or zero if it doesn't hold a whole plane
+auto decode_plane(std::span<const std::uint8_t> in, std::span<std::uint8_t> plane) -> std::size_t
+{
+    auto pos = std::size_t{0};
+    for (std::size_t i = 0; i != plane.size();) {
+        if (in.size() - pos < 2) return 0;
+        const auto value = in[pos];
+        const auto run = std::size_t{in[pos + 1]};
+        pos += 2;
+        if (run == 0 || run > plane.size() - i) return 0;
+        for (const auto end = i + run; i != end; ++i) {
+            plane[i] ^= value;
+        }
+    }
+    return pos;
+}
+
+auto to_byte(float channel) -> std::uint8_t
+{
+    return static_cast<std::uint8_t>(std::round(255.0f * std::clamp(channel, 0.0f, 1.0f)));
+}
+
+}
+
+video_recorder::video_recorder(std::size_t chunk_area, std::uint32_t keyframe_interval)
+    : d_chunk_area{chunk_area}
+    , d_keyframe_interval{std::max<std::uint32_t>(keyframe_interval, 1)}
+{
+}
+
+auto video_recorder::create(
+    const std::string& filename,
+    const world& pixels,
+    std::uint32_t keyframe_interval
+) -> std::unique_ptr<video_recorder>
+{
+    auto recorder = std::unique_ptr<video_recorder>{
+        new video_recorder{static_cast<std::size_t>(pixels.chunk_area()), keyframe_interval}
+    };
+    recorder->d_file.open(filename, std::ios::binary);
+    if (!recorder->d_file) {
+        std::print("could not record video to {}\n", filename);
+        return nullptr;
+    }
+
+    auto& out = recorder->d_file;
+    write(out, video_magic);
+    write(out, video_version);
+    write(out, static_cast<std::int32_t>(pixels.width()));
+    write(out, static_cast<std::int32_t>(pixels.height()));
+    write(out, static_cast<std::int32_t>(pixels.chunk_size()));
+    write(out, recorder->d_keyframe_interval);
+
+    const auto plane_size = pixels.get_chunks().size() * recorder->d_chunk_area;
+    recorder->d_types.assign(plane_size, 0);
+    recorder->d_shades.assign(plane_size, 0);
+
+    recorder->d_thread = std::jthread{[recorder = recorder.get()](std::stop_token token) {
+        recorder->run(token);
+    }};
+    return recorder;
+}
+
+auto video_recorder::capture(const world& pixels, job_system& jobs) -> void
+{
+    {
+        const auto lock = std::scoped_lock{d_mutex};
+        if (d_queue.size() >= max_queued_frames) {
+            // Leaving d_next_tick alone means the next frame picks up these changes too
+            d_merged.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    auto frame = captured_frame{};
+    frame.tick = pixels.tick();
+    frame.keyframe = d_frames % d_keyframe_interval == 0;
+
+    const auto& chunks = pixels.get_chunks();
+    for (std::size_t index = 0; index != chunks.size(); ++index) {
+        if (frame.keyframe || chunks[index].modified_tick >= d_next_tick) {
+            frame.chunks.push_back(static_cast<std::uint32_t>(index));
+        }
+    }
+
+    frame.types.resize(frame.chunks.size() * d_chunk_area);
+    frame.shades.resize(frame.chunks.size() * d_chunk_area);
+    const auto size = pixels.chunk_size();
+    jobs.parallel_for(frame.chunks.size(), chunks_per_encode_job, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i != end; ++i) {
+            const auto origin = pixels.get_chunk_pos(frame.chunks[i]) * size;
+            auto cell = i * d_chunk_area;
+            for (int y = 0; y != size; ++y) {
+                for (int x = 0; x != size; ++x) {
+                    const auto& px = pixels.at(origin + glm::ivec2{x, y});
+                    frame.types[cell] = static_cast<std::uint8_t>(px.type);
+                    frame.shades[cell] = px.shade;
+                    ++cell;
+                }
+            }
+        }
+    });
+
+    d_next_tick = pixels.tick();
+    ++d_frames;
+    {
+        const auto lock = std::scoped_lock{d_mutex};
+        d_queue.push_back(std::move(frame));
+    }
+    d_ready.notify_one();
+}
+
+auto video_recorder::run(std::stop_token token) -> void
+{
+    // Once stopped the queue is still drained, so nothing captured is lost
+    while (true) {
+        auto frame = captured_frame{};
+        {
+            auto lock = std::unique_lock{d_mutex};
+            d_ready.wait(lock, token, [&] { return !d_queue.empty(); });
+            if (d_queue.empty()) break;
+            frame = std::move(d_queue.front());
+            d_queue.pop_front();
+        }
+        encode(frame);
+    }
+    d_file.flush();
+}
+
+auto video_recorder::encode(const captured_frame& frame) -> void
+{
+    // A keyframe is the difference from nothing, so it can be decoded on its own
+    if (frame.keyframe) {
+        std::ranges::fill(d_types, 0);
+        std::ranges::fill(d_shades, 0);
+    }
+
+    auto payload = bytes{};
+    auto num_chunks = std::uint32_t{0};
+    auto encoded = bytes{};
+    for (std::size_t i = 0; i != frame.chunks.size(); ++i) {
+        const auto index = frame.chunks[i];
+        const auto offset = index * d_chunk_area;
+        encoded.clear();
+        auto changed = encode_plane(
+            std::span{frame.types}.subspan(i * d_chunk_area, d_chunk_area),
+            std::span{d_types}.subspan(offset, d_chunk_area),
+            encoded
+        );
+        changed |= encode_plane(
+            std::span{frame.shades}.subspan(i * d_chunk_area, d_chunk_area),
+            std::span{d_shades}.subspan(offset, d_chunk_area),
+            encoded
+        );
+
+        // Chunks are captured if they may have changed, many haven't
+        if (!changed && !frame.keyframe) continue;
+        append(payload, index);
+        append(payload, static_cast<std::uint32_t>(encoded.size()));
+        payload.insert(payload.end(), encoded.begin(), encoded.end());
+        ++num_chunks;
+    }
+
+    write(d_file, frame.tick);
+    write(d_file, static_cast<std::uint8_t>(frame.keyframe));
+    write(d_file, num_chunks);
+    write(d_file, static_cast<std::uint32_t>(payload.size()));
+    write_bytes(d_file, payload);
+}
+
+auto video_player::open(const std::string& filename, const world& pixels) -> std::unique_ptr<video_player>
+{
+    auto player = std::unique_ptr<video_player>{new video_player{}};
+    auto& file = player->d_file;
+    file.open(filename, std::ios::binary);
+    if (!file) {
+        std::print("could not open video {}\n", filename);
+        return nullptr;
+    }
+
+    auto magic = std::uint32_t{0};
+    auto version = std::uint32_t{0};
+    auto width = std::int32_t{0};
+    auto height = std::int32_t{0};
+    auto chunk_size = std::int32_t{0};
+    auto keyframe_interval = std::uint32_t{0};
+    if (!read(file, magic) || !read(file, version) || !read(file, width) || !read(file, height)
+        || !read(file, chunk_size) || !read(file, keyframe_interval)
+        || magic != video_magic || version != video_version)
+    {
+        std::print("{} is not a video\n", filename);
+        return nullptr;
+    }
+    if (width != pixels.width() || height != pixels.height() || chunk_size != pixels.chunk_size()) {
+        std::print("{} was recorded from a {}x{} world with {} pixel chunks\n", filename, width, height, chunk_size);
+        return nullptr;
+    }
+
+    // Only the headers are read up front, a video that was cut short ends at its last
+    // complete frame
+    const auto end = file.seekg(0, std::ios::end).tellg();
+    file.seekg(video_header_size, std::ios::beg);
+    while (true) {
+        auto entry = frame_entry{};
+        auto keyframe = std::uint8_t{0};
+        if (!read(file, entry.tick) || !read(file, keyframe) || !read(file, entry.num_chunks) || !read(file, entry.size)) {
+            break;
+        }
+        entry.keyframe = keyframe != 0;
+        entry.offset = file.tellg();
+        if (end - entry.offset < static_cast<std::streamoff>(entry.size)) break;
+        player->d_frames.push_back(entry);
+        file.seekg(entry.size, std::ios::cur);
+    }
+    file.clear();
+
+    if (player->d_frames.empty() || !player->d_frames.front().keyframe) {
+        std::print("{} has no frames\n", filename);
+        return nullptr;
+    }
+
+    player->d_chunk_area = static_cast<std::size_t>(pixels.chunk_area());
+    const auto plane_size = pixels.get_chunks().size() * player->d_chunk_area;
+    player->d_types.assign(plane_size, 0);
+    player->d_shades.assign(plane_size, 0);
+    if (!player->seek(0)) {
+        std::print("{} is corrupt\n", filename);
+        return nullptr;
+    }
+    return player;
+}
+
+auto video_player::apply(const frame_entry& frame) -> bool
+{
+    auto payload = bytes(frame.size);
+    d_file.seekg(frame.offset);
+    if (!read_bytes(d_file, payload)) {
+        d_file.clear();
+        return false;
+    }
+
+    const auto num_chunks = d_types.size() / d_chunk_area;
+    auto data = std::span<const std::uint8_t>{payload};
+    for (std::uint32_t i = 0; i != frame.num_chunks; ++i) {
+        auto index = std::uint32_t{0};
+        auto size = std::uint32_t{0};
+        if (data.size() < sizeof(index) + sizeof(size)) return false;
+        std::memcpy(&index, data.data(), sizeof(index));
+        std::memcpy(&size, data.data() + sizeof(index), sizeof(size));
+        data = data.subspan(sizeof(index) + sizeof(size));
+        if (index >= num_chunks || size > data.size()) return false;
+
+        const auto encoded = data.first(size);
+        const auto offset = index * d_chunk_area;
+        const auto types_size = decode_plane(encoded, std::span{d_types}.subspan(offset, d_chunk_area));
+        if (types_size == 0) return false;
+        const auto shades_size = decode_plane(encoded.subspan(types_size), std::span{d_shades}.subspan(offset, d_chunk_area));
+        if (shades_size == 0 || types_size + shades_size != size) return false;
+        data = data.subspan(size);
+    }
+    return data.empty();
+}
+
+auto video_player::seek(std::size_t frame) -> bool
+{
+    if (frame >= d_frames.size()) return false;
+
+    if (d_decoded && frame == d_current) return true;
+
+    // Carry on from the current frame if no keyframe lies between, otherwise start over
+    auto start = frame;
+    while (start > 0 && !d_frames[start].keyframe) {
+        --start;
+    }
+    const auto resume = d_decoded && frame > d_current && start <= d_current;
+    if (resume) {
+        start = d_current + 1;
+    } else if (!d_frames[start].keyframe) {
+        return false;
+    }
+
+    // Decoded into copies so a corrupt frame leaves the current one as it was
+    auto types = d_types;
+    auto shades = d_shades;
+    if (!resume) {
+        std::ranges::fill(d_types, 0);
+        std::ranges::fill(d_shades, 0);
+    }
+    for (auto i = start; i != frame + 1; ++i) {
+        if (!apply(d_frames[i])) {
+            d_types = std::move(types);
+            d_shades = std::move(shades);
+            return false;
+        }
+    }
+    d_current = frame;
+    d_decoded = true;
+    return true;
+}
+
+auto video_player::show(world& pixels) const -> void
+{
+    const auto size = pixels.chunk_size();
+    for (std::size_t index = 0; index != pixels.get_chunks().size(); ++index) {
+        const auto origin = pixels.get_chunk_pos(index) * size;
+        auto cell = index * d_chunk_area;
+        for (int y = 0; y != size; ++y) {
+            for (int x = 0; x != size; ++x) {
+                const auto type = static_cast<pixel_type>(std::min<std::size_t>(d_types[cell], num_pixel_types - 1));
+                pixels.at(origin + glm::ivec2{x, y}) = pixel{
+                    .type = type,
+                    .colour = from_shade(type, d_shades[cell]),
+                    .velocity = {0.0f, 0.0f},
+                    .flags = {},
+                    .shade = d_shades[cell]
+                };
+                ++cell;
+            }
+        }
+    }
+    pixels.set_tick(pixels.tick() + 1);
+    pixels.end_restore();
+}
+
+auto export_image(const world& pixels, const std::string& filename) -> bool
+{
+    auto file = std::ofstream{filename, std::ios::binary};
+    if (!file) {
+        std::print("could not write {}\n", filename);
+        return false;
+    }
+
+    const auto header = std::format("P6\n{} {}\n255\n", pixels.width(), pixels.height());
+    file.write(header.data(), static_cast<std::streamsize>(header.size()));
+    auto row = bytes(3 * static_cast<std::size_t>(pixels.width()));
+    for (int y = 0; y != pixels.height(); ++y) {
+        for (int x = 0; x != pixels.width(); ++x) {
+            const auto& colour = pixels.at({x, y}).colour;
+            row[3 * x + 0] = to_byte(colour.x);
+            row[3 * x + 1] = to_byte(colour.y);
+            row[3 * x + 2] = to_byte(colour.z);
+        }
+        write_bytes(file, row);
+    }
+    return static_cast<bool>(file);
+}
+
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include "world.hpp"
+#include "job_system.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sand {
+
+// Records what the world looks like, the type and shade of every pixel, once per tick
+// for watching back later without simulating it again. Each frame holds only the
+// chunks modified since the last, as the difference from the previous frame run length
+// encoded, with every chunk written in a keyframe every so often so a player can seek
+// without decoding from the start.
+//
+// Capturing copies the types and shades of the modified chunks out on the simulation
+// thread, everything else happens on a background thread. If that falls behind, frames
+// are merged into the next rather than queued without limit.
+class video_recorder
+{
+    struct captured_frame
+    {
+        std::uint64_t              tick     = 0;
+        bool                       keyframe = false;
+        std::vector<std::uint32_t> chunks;
+        std::vector<std::uint8_t>  types;  // A chunk area of each per captured chunk
+        std::vector<std::uint8_t>  shades;
+    };
+
+    std::size_t   d_chunk_area;
+    std::uint32_t d_keyframe_interval;
+    std::uint64_t d_frames    = 0;
+    std::uint64_t d_next_tick = 0;
+
+    // Only used by the background thread
+    std::ofstream             d_file;
+    std::vector<std::uint8_t> d_types;
+    std::vector<std::uint8_t> d_shades;
+
+    std::mutex                  d_mutex;
+    std::condition_variable_any d_ready;
+    std::deque<captured_frame>  d_queue;
+    std::atomic<std::size_t>    d_merged = 0;
+
+    // Writes queued frames to the file, stopped before the queue and file are destroyed
+    std::jthread d_thread;
+
+    auto run(std::stop_token token) -> void;
+    auto encode(const captured_frame& frame) -> void;
+
+    video_recorder(const video_recorder&) = delete;
+    video_recorder& operator=(const video_recorder&) = delete;
+
+    video_recorder(std::size_t chunk_area, std::uint32_t keyframe_interval);
+
+public:
+    // Five seconds at the tick rate
+    static constexpr std::uint32_t default_keyframe_interval = 300;
+
+    // Returns null if the file can't be written
+    static auto create(
+        const std::string& filename,
+        const world& pixels,
+        std::uint32_t keyframe_interval = default_keyframe_interval
+    ) -> std::unique_ptr<video_recorder>;
+
+    // Simulation thread only, called once per tick. Frames still queued are written
+    // before the recorder is destroyed.
+    auto capture(const world& pixels, job_system& jobs) -> void;
+
+    // Frames folded into a later one because encoding was behind
+    auto merged() const -> std::size_t { return d_merged.load(std::memory_order_relaxed); }
+};
+
+// Reads back a video, decoding any frame on request. Seeking forwards applies the
+// frames in between, seeking elsewhere starts again from the nearest keyframe.
+class video_player
+{
+    struct frame_entry
+    {
+        std::uint64_t  tick       = 0;
+        bool           keyframe   = false;
+        std::uint32_t  num_chunks = 0;
+        std::uint32_t  size       = 0;
+        std::streamoff offset     = 0;
+    };
+
+    std::ifstream             d_file;
+    std::vector<frame_entry>  d_frames;
+    std::size_t               d_chunk_area = 0;
+    std::size_t               d_current    = 0;
+    bool                      d_decoded    = false;
+    std::vector<std::uint8_t> d_types;
+    std::vector<std::uint8_t> d_shades;
+
+    auto apply(const frame_entry& frame) -> bool;
+
+    video_player() = default;
+
+public:
+    // Returns null if the file can't be read or was recorded from a different size of world
+    static auto open(const std::string& filename, const world& pixels) -> std::unique_ptr<video_player>;
+
+    auto num_frames() const -> std::size_t { return d_frames.size(); }
+    auto current() const -> std::size_t { return d_current; }
+    auto tick() const -> std::uint64_t { return d_frames[d_current].tick; }
+
+    // Returns false if the file is corrupt, the current frame is then unchanged
+    auto seek(std::size_t frame) -> bool;
+
+    // Writes the current frame into the world, which is stamped as changed throughout
+    auto show(world& pixels) const -> void;
+};
+
+// Writes the colours of the world as a binary PPM image
+auto export_image(const world& pixels, const std::string& filename) -> bool;
+
+// What the editor shows in place of the simulation while a video is open
+struct video_playback
+{
+    std::unique_ptr<video_player> player;
+    std::unique_ptr<world>        pixels;
+    int                           frame = 0;
+};
+
+}
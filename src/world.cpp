@@ -2,8 +2,10 @@
 #include "pixel.hpp"
 #include "update.hpp"
 #include "utility.hpp"
+#include "job_system.hpp"
 
 #include <cassert>
+#include <cmath>
 #include <algorithm>
 #include <ranges>
 
@@ -12,133 +14,691 @@ namespace {
 
 static const auto default_pixel = pixel::air();
 
-auto get_pos(glm::vec2 pos) -> std::size_t
+// Chunks owed more ticks than this drop the extra time rather than owing it forever
+static constexpr int max_lag = 60;
+
+// How many chunks to hand to each job when working over the whole world in parallel
+static constexpr std::size_t chunks_per_job = 16;
+
+// Spreads the low 16 bits of x out to the even bits
+constexpr auto part_by_one(std::uint32_t x) -> std::uint32_t
+{
+    x &= 0x0000ffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+auto get_index_in_chunk(glm::ivec2 local, int chunk_size) -> std::size_t
+{
+    if constexpr (sand::config::morton_tiles) {
+        assert((chunk_size & (chunk_size - 1)) == 0);
+        return part_by_one(local.x) | (part_by_one(local.y) << 1);
+    } else {
+        return local.x + chunk_size * local.y;
+    }
+}
+
+auto add_type(chunk& c, pixel_type type) -> void
+{
+    const auto index = static_cast<std::size_t>(type);
+    if (c.type_counts[index]++ == 0) {
+        c.types |= type_bit(type);
+    }
+}
+
+auto remove_type(chunk& c, pixel_type type) -> void
+{
+    const auto index = static_cast<std::size_t>(type);
+    assert(c.type_counts[index] > 0);
+    if (--c.type_counts[index] == 0) {
+        c.types &= ~type_bit(type);
+    }
+}
+
+}
+
+template <typename Geometry>
+basic_world<Geometry>::basic_world(const Geometry& geometry)
+    : d_geometry{geometry}
+    , d_pixels(static_cast<std::size_t>(geometry.width()) * geometry.height())
+    , d_chunks(static_cast<std::size_t>(geometry.chunks_wide()) * geometry.chunks_high())
+{
+    fill(pixel::air());
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::get_pos(glm::ivec2 pos) const -> std::size_t
+{
+    const auto chunk = pos / chunk_size();
+    const auto local = pos % chunk_size();
+    return get_chunk_index(chunk) * chunk_area() + get_index_in_chunk(local, chunk_size());
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::get_chunk(glm::ivec2 pos) -> chunk&
+{
+    return d_chunks[get_chunk_index(pos / chunk_size())];
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::wake_chunk(std::size_t index) -> void
+{
+    d_chunks[index].should_step_next = true;
+    d_chunks[index].awake_tick = d_stamp_tick;
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::set_update_period(std::size_t index, int period) -> void
+{
+    assert(period >= 0);
+    d_chunks[index].update_period = period;
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::is_chunk_due(std::size_t index) const -> bool
+{
+    return d_chunks[index].update_period != 0 && pending_ticks(index) > 0;
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::pending_ticks(std::size_t index) const -> int
+{
+    // Offset by the index so chunks with the same period don't all land on one tick
+    const auto& chunk = d_chunks[index];
+    const auto period = chunk.update_period;
+    const auto on_schedule = period != 0 && (d_tick + index) % period == 0;
+    return chunk.lag + (on_schedule ? period : 0);
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::take_pending_ticks(std::size_t index, int max) -> int
 {
-    return pos.x + sand::config::num_pixels * pos.y;
+    const auto pending = pending_ticks(index);
+    const auto taken = std::min(pending, max);
+    d_chunks[index].lag = pending - taken;
+    if (taken > 0) {
+        d_chunks[index].modified_tick = d_stamp_tick;
+    }
+    if (d_chunks[index].lag > 0) {
+        d_chunks[index].should_step_next = true;
+    }
+    return taken;
 }
 
+template <typename Geometry>
+auto basic_world<Geometry>::defer_chunk(std::size_t index) -> void
+{
+    d_chunks[index].lag = std::min(pending_ticks(index), max_lag);
+    d_chunks[index].should_step_next = true;
 }
 
-auto get_chunk_index(glm::ivec2 chunk) -> std::size_t
+template <typename Geometry>
+auto basic_world<Geometry>::get_chunk_index(glm::ivec2 chunk) const -> std::size_t
 {
-    return num_chunks * chunk.y + chunk.x;
+    return chunks_wide() * chunk.y + chunk.x;
 }
 
-auto get_chunk_pos(std::size_t index) -> glm::ivec2
+template <typename Geometry>
+auto basic_world<Geometry>::get_chunk_pos(std::size_t index) const -> glm::ivec2
 {
-    return {index % num_chunks, index / num_chunks};
+    return {index % chunks_wide(), index / chunks_wide()};
 }
 
-world::world()
+template <typename Geometry>
+auto basic_world<Geometry>::valid(glm::ivec2 pos) const -> bool
 {
-    d_pixels.fill(pixel::air());
+    return 0 <= pos.x && pos.x < width() && 0 <= pos.y && pos.y < height();
 }
 
-auto world::valid(glm::ivec2 pos) const -> bool
+template <typename Geometry>
+auto basic_world<Geometry>::valid_chunk(glm::ivec2 chunk) const -> bool
 {
-    return 0 <= pos.x && pos.x < sand::config::num_pixels && 0 <= pos.y && pos.y < sand::config::num_pixels;
+    return 0 <= chunk.x && chunk.x < chunks_wide() && 0 <= chunk.y && chunk.y < chunks_high();
 }
 
-auto world::set(glm::ivec2 pos, const pixel& pixel) -> void
+template <typename Geometry>
+auto basic_world<Geometry>::set(glm::ivec2 pos, const pixel& pixel) -> void
 {
     assert(valid(pos));
     wake_chunk_with_pixel(pos);
-    d_pixels[get_pos(pos)] = pixel;
+    auto& dst = d_pixels[get_pos(pos)];
+    if (dst.type != pixel.type) {
+        auto& c = get_chunk(pos);
+        remove_type(c, dst.type);
+        add_type(c, pixel.type);
+    }
+    dst = pixel;
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::put(glm::ivec2 pos, const pixel& pixel) -> void
+{
+    auto& dst = d_pixels[get_pos(pos)];
+    if (dst.type != pixel.type) {
+        auto& c = get_chunk(pos);
+        remove_type(c, dst.type);
+        add_type(c, pixel.type);
+    }
+    dst = pixel;
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::fill_span(int y, int x_begin, int x_end, pixel_type type) -> void
+{
+    auto& scratch = job_system::scratch();
+    const auto scope = scratch_scope{scratch};
+    auto row = scratch.allocate<pixel>(static_cast<std::size_t>(x_end - x_begin));
+    make_pixels(type, row);
+
+    // A chunk's part of the row is contiguous unless the chunks are Morton ordered,
+    // either way the type counts are updated once per chunk
+    for (int x = x_begin; x < x_end;) {
+        const auto chunk_end = std::min(x_end, (x / chunk_size() + 1) * chunk_size());
+        auto& c = get_chunk({x, y});
+        if constexpr (!sand::config::morton_tiles) {
+            const auto dst = d_pixels.pixels().subspan(get_pos({x, y}), chunk_end - x);
+            for (const auto& pixel : dst) {
+                remove_type(c, pixel.type);
+            }
+            std::ranges::copy(row.subspan(x - x_begin, chunk_end - x), dst.begin());
+        } else {
+            for (int i = x; i != chunk_end; ++i) {
+                remove_type(c, d_pixels[get_pos({i, y})].type);
+                d_pixels[get_pos({i, y})] = row[i - x_begin];
+            }
+        }
+        c.type_counts[static_cast<std::size_t>(type)] += chunk_end - x;
+        c.types |= type_bit(type);
+        x = chunk_end;
+    }
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::wake_region(glm::ivec2 top_left, glm::ivec2 bottom_right) -> void
+{
+    const auto first = top_left / chunk_size();
+    const auto last = bottom_right / chunk_size();
+    for (int y = first.y - 1; y <= last.y + 1; ++y) {
+        for (int x = first.x - 1; x <= last.x + 1; ++x) {
+            if (!valid_chunk({x, y})) continue;
+            const auto index = get_chunk_index({x, y});
+            wake_chunk(index);
+            if (x >= first.x && x <= last.x && y >= first.y && y <= last.y) {
+                d_chunks[index].modified_tick = d_stamp_tick;
+            }
+        }
+    }
 }
 
-auto world::fill(const pixel& p) -> void
+template <typename Geometry>
+auto basic_world<Geometry>::wake_touched(std::span<const std::uint8_t> touched) -> void
 {
-    d_pixels.fill(p);
+    for (std::size_t index = 0; index != touched.size(); ++index) {
+        if (!touched[index]) continue;
+        d_chunks[index].modified_tick = d_stamp_tick;
+        const auto pos = get_chunk_pos(index);
+        for (int dy = -1; dy != 2; ++dy) {
+            for (int dx = -1; dx != 2; ++dx) {
+                const auto neighbour = pos + glm::ivec2{dx, dy};
+                if (valid_chunk(neighbour)) {
+                    wake_chunk(get_chunk_index(neighbour));
+                }
+            }
+        }
+    }
 }
 
-auto world::at(glm::ivec2 pos) const -> const pixel&
+template <typename Geometry>
+auto basic_world<Geometry>::flood_fill(glm::ivec2 seed, pixel_type type, const chunk_callback& before_write) -> std::size_t
+{
+    if (!valid(seed)) return 0;
+    const auto target = at(seed).type;
+    if (target == type) return 0;
+
+    auto& scratch = job_system::scratch();
+    const auto scope = scratch_scope{scratch};
+    auto touched = scratch.allocate<std::uint8_t>(d_chunks.size());
+    std::ranges::fill(touched, 0);
+    auto stack = std::vector<glm::ivec2>{seed};
+    auto filled = std::size_t{0};
+
+    // Pushes one seed for each run of target pixels on row y within [x_begin, x_end)
+    const auto push_runs = [&](int y, int x_begin, int x_end) {
+        if (y < 0 || y >= height()) return;
+        auto in_run = false;
+        for (int x = x_begin; x != x_end; ++x) {
+            const auto matches = at({x, y}).type == target;
+            if (matches && !in_run) {
+                stack.push_back({x, y});
+            }
+            in_run = matches;
+        }
+    };
+
+    while (!stack.empty()) {
+        const auto pos = stack.back();
+        stack.pop_back();
+        if (at(pos).type != target) continue; // Filled since it was pushed
+
+        auto x_begin = pos.x;
+        auto x_end = pos.x + 1;
+        while (x_begin > 0 && at({x_begin - 1, pos.y}).type == target) --x_begin;
+        while (x_end < width() && at({x_end, pos.y}).type == target) ++x_end;
+
+        for (int chunk_x = x_begin / chunk_size(); chunk_x <= (x_end - 1) / chunk_size(); ++chunk_x) {
+            const auto index = get_chunk_index({chunk_x, pos.y / chunk_size()});
+            if (!touched[index]) {
+                touched[index] = 1;
+                if (before_write) before_write(index);
+            }
+        }
+        fill_span(pos.y, x_begin, x_end, type);
+        filled += x_end - x_begin;
+
+        push_runs(pos.y - 1, x_begin, x_end);
+        push_runs(pos.y + 1, x_begin, x_end);
+    }
+
+    wake_touched(touched);
+    return filled;
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::replace_type(
+    glm::ivec2 top_left,
+    glm::ivec2 size,
+    pixel_type from,
+    pixel_type to,
+    const chunk_callback& before_write
+) -> std::size_t
+{
+    const auto first = glm::max(top_left, glm::ivec2{0, 0});
+    const auto last = glm::min(top_left + size, glm::ivec2{width(), height()}) - 1;
+    if (from == to || first.x > last.x || first.y > last.y) return 0;
+
+    auto& scratch = job_system::scratch();
+    const auto scope = scratch_scope{scratch};
+    auto touched = scratch.allocate<std::uint8_t>(d_chunks.size());
+    std::ranges::fill(touched, 0);
+    auto replaced = std::size_t{0};
+
+    for (int y = first.y; y <= last.y; ++y) {
+        for (int x = first.x; x <= last.x;) {
+            // Chunks without the type are skipped whole using their counts
+            const auto index = get_chunk_index(glm::ivec2{x, y} / chunk_size());
+            const auto chunk_end = std::min(last.x + 1, (x / chunk_size() + 1) * chunk_size());
+            if (!d_chunks[index].contains_any(type_bit(from))) {
+                x = chunk_end;
+                continue;
+            }
+            if (at({x, y}).type != from) {
+                ++x;
+                continue;
+            }
+
+            auto run_end = x + 1;
+            while (run_end != chunk_end && at({run_end, y}).type == from) ++run_end;
+            if (!touched[index]) {
+                touched[index] = 1;
+                if (before_write) before_write(index);
+            }
+            fill_span(y, x, run_end, to);
+            replaced += run_end - x;
+            x = run_end;
+        }
+    }
+
+    wake_touched(touched);
+    return replaced;
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::fill_rect(glm::ivec2 top_left, glm::ivec2 size, pixel_type type) -> void
+{
+    const auto first = glm::max(top_left, glm::ivec2{0, 0});
+    const auto last = glm::min(top_left + size, glm::ivec2{width(), height()}) - 1;
+    if (first.x > last.x || first.y > last.y) return;
+    for (int y = first.y; y <= last.y; ++y) {
+        fill_span(y, first.x, last.x + 1, type);
+    }
+    wake_region(first, last);
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::fill_circle(glm::ivec2 centre, float radius, pixel_type type) -> void
+{
+    if (radius < 0.0f) return;
+    const auto r = static_cast<int>(radius);
+    const auto first = glm::max(centre - r, glm::ivec2{0, 0});
+    const auto last = glm::min(centre + r, glm::ivec2{width() - 1, height() - 1});
+    if (first.x > last.x || first.y > last.y) return;
+    for (int y = first.y; y <= last.y; ++y) {
+        const auto dy = static_cast<float>(y - centre.y);
+        const auto half = static_cast<int>(std::sqrt(radius * radius - dy * dy));
+        const auto x_begin = std::max(centre.x - half, 0);
+        const auto x_end = std::min(centre.x + half + 1, width());
+        if (x_begin < x_end) {
+            fill_span(y, x_begin, x_end, type);
+        }
+    }
+    wake_region(first, last);
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::blit(glm::ivec2 top_left, glm::ivec2 size, std::span<const pixel> pixels) -> void
+{
+    assert(pixels.size() == static_cast<std::size_t>(size.x) * size.y);
+    const auto first = glm::max(top_left, glm::ivec2{0, 0});
+    const auto last = glm::min(top_left + size, glm::ivec2{width(), height()}) - 1;
+    if (first.x > last.x || first.y > last.y) return;
+    for (int y = first.y; y <= last.y; ++y) {
+        const auto row = pixels.subspan(static_cast<std::size_t>(y - top_left.y) * size.x, size.x);
+        for (int x = first.x; x <= last.x; ++x) {
+            put({x, y}, row[x - top_left.x]);
+        }
+    }
+    wake_region(first, last);
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::fill(const pixel& p) -> void
+{
+    std::ranges::fill(d_pixels.pixels(), p);
+    for (auto& chunk : d_chunks) {
+        chunk.type_counts.fill(0);
+        chunk.type_counts[static_cast<std::size_t>(p.type)] = chunk_area();
+        chunk.types = type_bit(p.type);
+        chunk.modified_tick = d_stamp_tick;
+    }
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::at(glm::ivec2 pos) const -> const pixel&
 {
     assert(valid(pos));
     return d_pixels[get_pos(pos)];
 }
 
-auto world::at(glm::ivec2 pos) -> pixel&
+template <typename Geometry>
+auto basic_world<Geometry>::at(glm::ivec2 pos) -> pixel&
 {
     assert(valid(pos));
     return d_pixels[get_pos(pos)];
 }
 
-auto world::swap(glm::ivec2 lhs, glm::ivec2 rhs) -> glm::ivec2
+template <typename Geometry>
+auto basic_world<Geometry>::swap(glm::ivec2 lhs, glm::ivec2 rhs) -> glm::ivec2
 {
     wake_chunk_with_pixel(lhs);
     wake_chunk_with_pixel(rhs);
-    std::swap(at(lhs), at(rhs));
+    auto& a = at(lhs);
+    auto& b = at(rhs);
+    if (a.type != b.type) {
+        auto& lhs_chunk = get_chunk(lhs);
+        auto& rhs_chunk = get_chunk(rhs);
+        if (&lhs_chunk != &rhs_chunk) {
+            remove_type(lhs_chunk, a.type);
+            add_type(lhs_chunk, b.type);
+            remove_type(rhs_chunk, b.type);
+            add_type(rhs_chunk, a.type);
+        }
+    }
+    std::swap(a, b);
     return rhs;
 }
 
-auto world::wake_chunk_with_pixel(glm::ivec2 pixel) -> void
+template <typename Geometry>
+auto basic_world<Geometry>::wake_chunk_with_pixel(glm::ivec2 pixel) -> void
 {
-    const auto chunk = pixel / sand::config::chunk_size;
-    d_chunks[get_chunk_index(chunk)].should_step_next = true;
+    const auto chunk = pixel / chunk_size();
+    const auto index = get_chunk_index(chunk);
+    wake_chunk(index);
+    d_chunks[index].modified_tick = d_stamp_tick;
 
     // Wake right
-    if (pixel.x != sand::config::num_pixels - 1 && (pixel.x + 1) % sand::config::chunk_size == 0)
+    if (pixel.x != width() - 1 && (pixel.x + 1) % chunk_size() == 0)
     {
         const auto neighbour = chunk + glm::ivec2{1, 0};
-        if (valid(neighbour))
-            d_chunks[get_chunk_index(neighbour)].should_step_next = true;
+        if (valid_chunk(neighbour))
+            wake_chunk(get_chunk_index(neighbour));
     }
 
     // Wake left
-    if (pixel.x != 0 && (pixel.x - 1) % sand::config::chunk_size == 0)
+    if (pixel.x != 0 && (pixel.x - 1) % chunk_size() == 0)
     {
         const auto neighbour = chunk - glm::ivec2{1, 0};
-        if (valid(neighbour))
-            d_chunks[get_chunk_index(neighbour)].should_step_next = true;
+        if (valid_chunk(neighbour))
+            wake_chunk(get_chunk_index(neighbour));
     }
 
     // Wake down
-    if (pixel.y != sand::config::num_pixels - 1 && (pixel.y + 1) % sand::config::chunk_size == 0)
+    if (pixel.y != height() - 1 && (pixel.y + 1) % chunk_size() == 0)
     {
         const auto neighbour = chunk + glm::ivec2{0, 1};
-        if (valid(neighbour))
-            d_chunks[get_chunk_index(neighbour)].should_step_next = true;
+        if (valid_chunk(neighbour))
+            wake_chunk(get_chunk_index(neighbour));
     }
 
     // Wake up
-    if (pixel.y != 0 && (pixel.y - 1) % sand::config::chunk_size == 0)
+    if (pixel.y != 0 && (pixel.y - 1) % chunk_size() == 0)
     {
         const auto neighbour = chunk - glm::ivec2{0, 1};
-        if (valid(neighbour))
-            d_chunks[get_chunk_index(neighbour)].should_step_next = true;
+        if (valid_chunk(neighbour))
+            wake_chunk(get_chunk_index(neighbour));
     }
 }
 
-auto world::wake_all_chunks() -> void
+template <typename Geometry>
+auto basic_world<Geometry>::wake_all_chunks() -> void
 {
     for (auto& chunk : d_chunks) {
         chunk.should_step_next = true;
         chunk.should_step = true;
+        chunk.awake_tick = d_stamp_tick;
     }
 }
 
-auto world::num_awake_chunks() const -> std::size_t
+template <typename Geometry>
+auto basic_world<Geometry>::num_awake_chunks() const -> std::size_t
 {  
-    return std::count_if(d_chunks.begin(), d_chunks.end(), [](chunk c) {
+    return std::count_if(d_chunks.begin(), d_chunks.end(), [](const chunk& c) {
         return c.should_step;
     });
 }
 
-auto world::new_frame() -> void
+template <typename Geometry>
+auto basic_world<Geometry>::new_frame(job_system& jobs) -> void
+{
+    ++d_tick;
+    d_stamp_tick = d_tick;
+    jobs.parallel_for(d_chunks.size(), chunks_per_job, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t index = begin; index != end; ++index) {
+            auto& chunk = d_chunks[index];
+            chunk.should_step = std::exchange(chunk.should_step_next, false);
+            if (chunk.should_step) {
+                if (is_chunk_due(index)) {
+                    chunk.awake_tick = d_tick;
+                } else {
+                    chunk.should_step_next = true;
+                }
+            }
+            for (auto& pixel : chunk_pixels(index)) {
+                pixel.flags[is_updated] = false;
+            }
+        }
+    });
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::begin_edits() -> void
+{
+    d_stamp_tick = d_tick + 1;
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::sync_from(const basic_world& other, job_system& jobs) -> void
+{
+    assert(d_pixels.size() == other.d_pixels.size());
+    jobs.parallel_for(d_chunks.size(), chunks_per_job, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t index = begin; index != end; ++index) {
+            if (d_chunks[index].awake_tick != other.d_chunks[index].awake_tick) {
+                std::ranges::copy(other.chunk_pixels(index), chunk_pixels(index).begin());
+            }
+            d_chunks[index] = other.d_chunks[index];
+        }
+    });
+    d_tick = other.d_tick;
+    d_stamp_tick = other.d_stamp_tick;
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::replace(basic_world&& other) -> void
+{
+    assert(d_pixels.size() == other.d_pixels.size());
+    if (d_pixels.file()) {
+        std::ranges::copy(other.d_pixels.pixels(), d_pixels.pixels().begin());
+    } else {
+        d_pixels = std::move(other.d_pixels);
+    }
+    d_chunks = std::move(other.d_chunks);
+    mark_all_changed();
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::adopt_storage(pixel_storage storage, const chunks& states) -> void
+{
+    assert(storage.size() == d_pixels.size());
+    assert(states.size() == d_chunks.size());
+    d_pixels = std::move(storage);
+    d_chunks = states;
+    mark_all_changed();
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::is_chunk_awake(glm::ivec2 pixel) const -> bool
+{
+    const auto chunk = pixel / chunk_size();
+    return d_chunks[get_chunk_index(chunk)].should_step;
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::count(pixel_type type) const -> std::size_t
 {
+    auto total = std::size_t{0};
+    for (const auto& chunk : d_chunks) {
+        total += chunk.type_counts[static_cast<std::size_t>(type)];
+    }
+    return total;
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::chunk_pixels(std::size_t index) const -> std::span<const pixel>
+{
+    return d_pixels.pixels().subspan(index * chunk_area(), chunk_area());
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::chunk_pixels(std::size_t index) -> std::span<pixel>
+{
+    return d_pixels.pixels().subspan(index * chunk_area(), chunk_area());
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::exchange_chunk(std::size_t index, std::span<pixel> other) -> void
+{
+    assert(other.size() == static_cast<std::size_t>(chunk_area()));
+    std::ranges::swap_ranges(chunk_pixels(index), other);
+
+    auto& chunk = d_chunks[index];
+    chunk.type_counts.fill(0);
+    chunk.types = 0;
+    for (const auto& pixel : chunk_pixels(index)) {
+        add_type(chunk, pixel.type);
+    }
+    chunk.modified_tick = d_stamp_tick;
+
+    // Whatever borders the chunk may now be free to move, or blocked
+    const auto pos = get_chunk_pos(index);
+    for (int dy = -1; dy != 2; ++dy) {
+        for (int dx = -1; dx != 2; ++dx) {
+            if (valid_chunk(pos + glm::ivec2{dx, dy})) {
+                wake_chunk(get_chunk_index(pos + glm::ivec2{dx, dy}));
+            }
+        }
+    }
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::recount_chunk(std::size_t index) -> void
+{
+    auto& chunk = d_chunks[index];
+    chunk.type_counts.fill(0);
+    chunk.types = 0;
+    for (const auto& pixel : chunk_pixels(index)) {
+        add_type(chunk, pixel.type);
+    }
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::recount_chunks() -> void
+{
+    for (std::size_t index = 0; index != d_chunks.size(); ++index) {
+        recount_chunk(index);
+    }
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::recount_chunks(job_system& jobs) -> void
+{
+    jobs.parallel_for(d_chunks.size(), chunks_per_job, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t index = begin; index != end; ++index) {
+            recount_chunk(index);
+        }
+    });
+}
+
+template <typename Geometry>
+auto basic_world<Geometry>::mark_all_changed() -> void
+{
+    ++d_tick;
+    d_stamp_tick = d_tick;
     for (auto& chunk : d_chunks) {
-        chunk.should_step = std::exchange(chunk.should_step_next, false);
+        chunk.awake_tick = d_tick;
+        chunk.modified_tick = d_tick;
     }
+}
 
-    for (auto& pixel : d_pixels) {
-        pixel.flags[is_updated] = false;
+template <typename Geometry>
+auto basic_world<Geometry>::set_tick(std::uint64_t tick) -> void
+{
+    d_tick = tick;
+    d_stamp_tick = tick;
+    for (auto& chunk : d_chunks) {
+        chunk.awake_tick = d_tick;
+        chunk.modified_tick = d_tick;
     }
 }
 
-auto world::is_chunk_awake(glm::ivec2 pixel) const -> bool
+template <typename Geometry>
+auto basic_world<Geometry>::restore_chunk_state(std::size_t index, bool should_step, bool should_step_next, int lag) -> void
 {
-    const auto chunk = pixel / sand::config::chunk_size;
-    return d_chunks[get_chunk_index(chunk)].should_step;
+    auto& chunk = d_chunks[index];
+    chunk.should_step = should_step;
+    chunk.should_step_next = should_step_next;
+    chunk.lag = std::clamp(lag, 0, max_lag);
 }
 
-}
\ No newline at end of file
+template <typename Geometry>
+auto basic_world<Geometry>::end_restore() -> void
+{
+    recount_chunks();
+    mark_all_changed();
+}
+
+template class basic_world<sand::config::geometry>;
+template class basic_world<dynamic_geometry>;
+
+}
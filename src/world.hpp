@@ -2,10 +2,17 @@
 #include "pixel.hpp"
 #include "serialise.hpp"
 #include "config.hpp"
+#include "geometry.hpp"
+#include "pixel_storage.hpp"
+
+#include <cereal/details/helpers.hpp>
 
 #include <cstdint>
+#include <functional>
 #include <unordered_set>
 #include <array>
+#include <span>
+#include <vector>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
@@ -13,29 +20,90 @@
 
 namespace sand {
 
-static constexpr int num_chunks = sand::config::num_pixels / sand::config::chunk_size;
+class job_system;
 
 struct chunk
 {
     bool should_step      = true;
     bool should_step_next = true;
+
+    // The last world tick in which this chunk was awake or woken, where a chunk woken
+    // between ticks counts as woken in the next. A chunk whose stamp has not moved on has
+    // not changed since then
+    std::uint64_t awake_tick = 0;
+
+    // The last world tick in which a pixel in this chunk may have been changed: set,
+    // swapped or filled, written to by its own update, or written through at() followed
+    // by wake_chunk_with_pixel. Incremental saves only write chunks stamped since the last.
+    std::uint64_t modified_tick = 0;
+
+    // How often the chunk is updated: every tick when 1, every n ticks with time scaled
+    // to match when n, and never when 0. An awake chunk stays awake until it is due.
+    int update_period = 1;
+
+    // Ticks of updates this chunk is owed because the update budget ran out before
+    // it was reached. Owed chunks are due every tick until they are caught up.
+    int lag = 0;
+
+    // Which pixel types are in this chunk and how many of each. Kept up to date by
+    // set, swap and fill, so type changes must not be made via at()
+    pixel_type_mask                              types       = 0;
+    std::array<std::uint32_t, num_pixel_types>   type_counts = {};
+
+    auto contains_any(pixel_type_mask mask) const -> bool { return types & mask; }
 };
 
-auto get_chunk_index(glm::ivec2 chunk) -> std::size_t;
-auto get_chunk_pos(std::size_t index) -> glm::ivec2;
+// Encoding, compressing or hashing a chunk is enough work for it to be a job of its own
+// when doing so for the whole world in parallel
+inline constexpr std::size_t chunks_per_encode_job = 1;
 
-class world
+template <typename Geometry>
+class basic_world
 {
 public:
-    using pixels = std::array<pixel, sand::config::num_pixels * sand::config::num_pixels>;
-    using chunks = std::array<chunk, num_chunks * num_chunks>;
+    using geometry = Geometry;
+    using pixels   = pixel_storage;
+    using chunks   = std::vector<chunk>;
 
 private:
-    pixels d_pixels;
-    chunks d_chunks;
+    Geometry      d_geometry;
+    pixels        d_pixels;
+    chunks        d_chunks;
+    std::uint64_t d_tick = 0;
+
+    // What changes are stamped with, the current tick while it runs and the next one once
+    // begin_edits is called
+    std::uint64_t d_stamp_tick = 0;
+
+    auto get_pos(glm::ivec2 pos) const -> std::size_t;
+    auto get_chunk(glm::ivec2 pos) -> chunk&;
+    auto wake_chunk(std::size_t index) -> void;
+    auto recount_chunk(std::size_t index) -> void;
+    auto recount_chunks() -> void;
+
+    // For bulk edits. Writes a pixel keeping the type counts but without waking anything,
+    // so wake_region must be called for the area once it is written
+    auto put(glm::ivec2 pos, const pixel& p) -> void;
+    auto fill_span(int y, int x_begin, int x_end, pixel_type type) -> void;
+    auto wake_region(glm::ivec2 top_left, glm::ivec2 bottom_right) -> void;
+
+    // Wakes each chunk flagged in touched, and its neighbours, once, and stamps the
+    // flagged chunks as modified
+    auto wake_touched(std::span<const std::uint8_t> touched) -> void;
+
+    // Moves the tick on and stamps every chunk as changed at it, without waking them,
+    // for when pixels have been replaced wholesale
+    auto mark_all_changed() -> void;
 
 public:
-    world();
+    explicit basic_world(const Geometry& geometry = {});
+
+    auto width() const -> int { return d_geometry.width(); }
+    auto height() const -> int { return d_geometry.height(); }
+    auto chunk_size() const -> int { return d_geometry.chunk_size(); }
+    auto chunk_area() const -> int { return chunk_size() * chunk_size(); }
+    auto chunks_wide() const -> int { return d_geometry.chunks_wide(); }
+    auto chunks_high() const -> int { return d_geometry.chunks_high(); }
 
     // Returns true if the given position exists and false otherwise
     auto valid(glm::ivec2 pos) const -> bool;
@@ -43,10 +111,67 @@ public:
     auto set(glm::ivec2 pos, const pixel& p) -> void;
     auto fill(const pixel& p) -> void;
 
+    // Bulk edits, for brushes. Rows are written directly with the colour noise for new
+    // pixels drawn in bulk, and each chunk touched is woken once rather than per pixel.
+    // Anything outside the world is ignored.
+    auto fill_rect(glm::ivec2 top_left, glm::ivec2 size, pixel_type type) -> void;
+    auto fill_circle(glm::ivec2 centre, float radius, pixel_type type) -> void;
+
+    // Called with the index of each chunk before a tool first writes to it, for undo
+    using chunk_callback = std::function<void(std::size_t)>;
+
+    // Fills the region of pixels connected to seed, along rows and columns, that are the
+    // same type as it. Works a row span at a time with an explicit stack, so the depth
+    // of the region doesn't matter. Returns the number of pixels filled.
+    auto flood_fill(glm::ivec2 seed, pixel_type type, const chunk_callback& before_write = {}) -> std::size_t;
+
+    // Changes every pixel of type from in the rectangle to type to. Returns the number of
+    // pixels changed.
+    auto replace_type(
+        glm::ivec2 top_left,
+        glm::ivec2 size,
+        pixel_type from,
+        pixel_type to,
+        const chunk_callback& before_write = {}
+    ) -> std::size_t;
+
+    // Copies pixels, size.x by size.y in row-major order, into the rectangle at top_left,
+    // waking each chunk touched once. Anything outside the world is ignored.
+    auto blit(glm::ivec2 top_left, glm::ivec2 size, std::span<const pixel> pixels) -> void;
+
     auto at(glm::ivec2 pos) const -> const pixel&;
     auto at(glm::ivec2 pos) -> pixel&;
 
-    auto new_frame() -> void;
+    // Advances the tick counter and moves chunks woken last tick to awake
+    auto new_frame(job_system& jobs) -> void;
+
+    // Changes made from now until the next new_frame are stamped with the next tick. A
+    // published copy already holds this tick's stamps, so edits made after it, such as
+    // from commands, must stamp a later one to be seen by sync_from and the renderer,
+    // whether or not the chunk is due to be updated next tick.
+    auto begin_edits() -> void;
+    auto tick() const -> std::uint64_t { return d_tick; }
+
+    // For replaying a recorded session, where chunk scheduling must line up with the
+    // recording. Every chunk is stamped as changed at the new tick.
+    auto set_tick(std::uint64_t tick) -> void;
+
+    // Makes this world a copy of other, which must be the same size, copying only
+    // the chunks whose awake tick differs
+    auto sync_from(const basic_world& other, job_system& jobs) -> void;
+
+    // Uses storage, which must hold every pixel in memory order, as this world's pixels
+    // without copying them, along with the matching chunk states. For file backed worlds.
+    auto adopt_storage(pixel_storage storage, const chunks& states) -> void;
+
+    // Rebuilds the type counts of every chunk from its pixels, a chunk per job
+    auto recount_chunks(job_system& jobs) -> void;
+    auto storage() const -> const pixel_storage& { return d_pixels; }
+
+    // Takes the pixels and chunk states of other, which must be the same size. Every chunk
+    // is stamped as changed at this world's tick, so copies synced from it see the change.
+    // A file backed world has the pixels copied into its file.
+    auto replace(basic_world&& other) -> void;
 
     // Returns the rhs
     auto swap(glm::ivec2 lhs, glm::ivec2 rhs) -> glm::ivec2;
@@ -57,12 +182,86 @@ public:
     auto num_awake_chunks() const -> std::size_t;
     auto is_chunk_awake(glm::ivec2 pixel) const -> bool;
 
+    auto set_update_period(std::size_t index, int period) -> void;
+    auto is_chunk_due(std::size_t index) const -> bool;
+
+    // The number of ticks the chunk's next update should cover, its period if this is
+    // one of its regular ticks plus any it is owed
+    auto pending_ticks(std::size_t index) const -> int;
+
+    // For a chunk that was due but skipped. It stays awake and is owed its pending ticks
+    auto defer_chunk(std::size_t index) -> void;
+
+    // Takes up to max of the chunk's pending ticks for an update, the rest stay owed
+    auto take_pending_ticks(std::size_t index, int max) -> int;
+
+    auto valid_chunk(glm::ivec2 chunk) const -> bool;
     auto get_chunks() const -> const chunks& { return d_chunks; }
+    auto get_chunk_index(glm::ivec2 chunk) const -> std::size_t;
+    auto get_chunk_pos(std::size_t index) const -> glm::ivec2;
+
+    // The pixels of a chunk as one contiguous block, in the order given by
+    // config::morton_tiles
+    auto chunk_pixels(std::size_t index) const -> std::span<const pixel>;
+    auto chunk_pixels(std::size_t index) -> std::span<pixel>;
+
+    // Swaps the pixels of a chunk with those given, which must be a whole chunk in the
+    // same order, then wakes it and its neighbours
+    auto exchange_chunk(std::size_t index, std::span<pixel> other) -> void;
 
-    auto serialise(auto& archive) -> void
+    // Total number of pixels of the given type, summed from the chunk counts
+    auto count(pixel_type type) const -> std::size_t;
+
+    // Saves store the pixels in row-major order, independent of the memory layout
+    auto save(auto& archive) const -> void
     {
-        archive(d_pixels);
+        for (int y = 0; y != height(); ++y) {
+            for (int x = 0; x != width(); ++x) {
+                archive(at({x, y}));
+            }
+        }
     }
+
+    // Throws cereal::Exception on a type that doesn't exist, as the type indexes the
+    // chunk counts and update tables. The world must then be cleared before use.
+    auto load(auto& archive) -> void
+    {
+        for (int y = 0; y != height(); ++y) {
+            for (int x = 0; x != width(); ++x) {
+                auto& px = at({x, y});
+                archive(px);
+                if (static_cast<std::size_t>(px.type) >= num_pixel_types) {
+                    throw cereal::Exception{"pixel type out of range"};
+                }
+                px.shade = to_shade(px);
+            }
+        }
+        recount_chunks();
+        mark_all_changed();
+    }
+
+    // Whether each chunk is awake and what it is owed, saved after the pixels so that
+    // a settled world loads settled rather than waking every chunk
+    auto save_chunk_states(auto& archive) const -> void
+    {
+        for (const auto& chunk : d_chunks) {
+            archive(chunk.should_step, chunk.should_step_next, chunk.lag);
+        }
+    }
+
+    auto load_chunk_states(auto& archive) -> void
+    {
+        for (auto& chunk : d_chunks) {
+            archive(chunk.should_step, chunk.should_step_next, chunk.lag);
+        }
+    }
+
+    // For loaders that write pixels directly through at(), one chunk at a time. Chunks
+    // may be restored in parallel, but end_restore must be called once they are all done
+    auto restore_chunk_state(std::size_t index, bool should_step, bool should_step_next, int lag) -> void;
+    auto end_restore() -> void;
 };
 
-}
\ No newline at end of file
+using world = basic_world<sand::config::geometry>;
+
+}
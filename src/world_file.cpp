@@ -0,0 +1,251 @@
+#include "world_file.hpp"
+#include "config.hpp"
+#include "mapped_file.hpp"
+#include "binary_io.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <print>
+#include <type_traits>
+
+namespace sand {
+namespace {
+
+static constexpr std::uint32_t world_file_magic = four_cc("SNDW");
+// Version 2 added the shade to each pixel, which went in what was padding
+static constexpr std::uint32_t world_file_version = 2;
+
+// Windows can only map views at multiples of this, so keep the pixels on one
+static constexpr std::size_t pixels_alignment = 1 << 16;
+
+struct world_file_header
+{
+    std::uint32_t magic       = world_file_magic;
+    std::uint32_t version     = world_file_version;
+    std::int32_t  width       = 0;
+    std::int32_t  height      = 0;
+    std::int32_t  chunk_size  = 0;
+    std::uint32_t morton      = sand::config::morton_tiles;
+    std::uint32_t pixel_size  = sizeof(pixel);
+    std::uint32_t pixel_types = num_pixel_types;
+    std::uint64_t pixels_offset = 0;
+
+    // The world tick when the file was last synced. Chunks stamped at or after it are
+    // dirty, as they may have been changed later in that same tick
+    std::uint64_t synced_tick = 0;
+};
+
+struct world_file_chunk
+{
+    std::uint8_t                                should_step      = 0;
+    std::uint8_t                                should_step_next = 0;
+    std::int32_t                                lag              = 0;
+
+    // For other processes inspecting the file, opening it rebuilds them from the pixels
+    std::array<std::uint32_t, num_pixel_types> type_counts      = {};
+};
+
+static_assert(std::is_trivially_copyable_v<world_file_header>);
+static_assert(std::is_trivially_copyable_v<world_file_chunk>);
+
+// Enough pixels that checking them is worth a job, about a 64x64 chunk
+static constexpr std::size_t pixels_per_job = 4096;
+
+// Types index the chunk counts and update tables, so a corrupt byte in the file must be
+// caught before the world uses it
+auto valid_types(std::span<const pixel> pixels, job_system& jobs) -> bool
+{
+    auto valid = std::atomic<bool>{true};
+    jobs.parallel_for(pixels.size(), pixels_per_job, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i != end; ++i) {
+            if (static_cast<std::size_t>(pixels[i].type) >= num_pixel_types) {
+                valid.store(false, std::memory_order_relaxed);
+                return;
+            }
+        }
+    });
+    return valid.load();
+}
+
+auto table_offset() -> std::size_t
+{
+    return sizeof(world_file_header);
+}
+
+auto pixels_offset(std::size_t num_chunks) -> std::size_t
+{
+    const auto table_end = table_offset() + num_chunks * sizeof(world_file_chunk);
+    return (table_end + pixels_alignment - 1) / pixels_alignment * pixels_alignment;
+}
+
+auto read_header(const mapped_file& file) -> world_file_header
+{
+    auto header = world_file_header{};
+    std::memcpy(&header, file.data(), sizeof(header));
+    return header;
+}
+
+auto write_header(const mapped_file& file, const world_file_header& header) -> void
+{
+    std::memcpy(file.data(), &header, sizeof(header));
+}
+
+template <typename Geometry>
+auto write_chunk_table(const mapped_file& file, const basic_world<Geometry>& pixels) -> void
+{
+    auto* table = file.data() + table_offset();
+    for (const auto& chunk : pixels.get_chunks()) {
+        const auto entry = world_file_chunk{
+            .should_step = chunk.should_step,
+            .should_step_next = chunk.should_step_next,
+            .lag = chunk.lag,
+            .type_counts = chunk.type_counts
+        };
+        std::memcpy(table, &entry, sizeof(entry));
+        table += sizeof(entry);
+    }
+}
+
+template <typename Geometry>
+auto read_chunk_table(const mapped_file& file, const basic_world<Geometry>& pixels) -> typename basic_world<Geometry>::chunks
+{
+    auto chunks = pixels.get_chunks();
+    const auto* table = file.data() + table_offset();
+    for (auto& chunk : chunks) {
+        auto entry = world_file_chunk{};
+        std::memcpy(&entry, table, sizeof(entry));
+        table += sizeof(entry);
+
+        chunk.should_step = entry.should_step;
+        chunk.should_step_next = entry.should_step_next;
+        chunk.lag = entry.lag;
+    }
+    return chunks;
+}
+
+}
+
+template <typename Geometry>
+auto create_world_file(basic_world<Geometry>& pixels, const std::string& filename) -> bool
+{
+    const auto num_chunks = pixels.get_chunks().size();
+    const auto num_pixels = pixels.storage().size();
+    const auto offset = pixels_offset(num_chunks);
+    auto file = mapped_file::create(filename, offset + num_pixels * sizeof(pixel));
+    if (!file) {
+        return false;
+    }
+
+    const auto current = pixels.storage().pixels();
+    std::memcpy(file->data() + offset, current.data(), current.size_bytes());
+    write_chunk_table(*file, pixels);
+
+    const auto chunks = pixels.get_chunks();
+    auto storage = pixel_storage{std::move(*file), offset, num_pixels};
+    pixels.adopt_storage(std::move(storage), chunks);
+
+    const auto& mapped = *pixels.storage().file();
+    write_header(mapped, world_file_header{
+        .width = pixels.width(),
+        .height = pixels.height(),
+        .chunk_size = pixels.chunk_size(),
+        .pixels_offset = offset,
+        .synced_tick = pixels.tick()
+    });
+    if (!mapped.flush(0, mapped.size()) || !mapped.commit()) {
+        std::print("could not write {}\n", filename);
+        return false;
+    }
+    return true;
+}
+
+template <typename Geometry>
+auto open_world_file(basic_world<Geometry>& pixels, const std::string& filename, job_system& jobs) -> bool
+{
+    auto file = mapped_file::open(filename, map_access::read_write);
+    if (!file) {
+        return false;
+    }
+
+    if (file->size() < sizeof(world_file_header)) {
+        std::print("{} is not a world file\n", filename);
+        return false;
+    }
+    const auto header = read_header(*file);
+    if (header.magic != world_file_magic) {
+        std::print("{} is not a world file\n", filename);
+        return false;
+    }
+    if (header.version != world_file_version
+        || header.morton != sand::config::morton_tiles
+        || header.pixel_size != sizeof(pixel)
+        || header.pixel_types != num_pixel_types)
+    {
+        std::print("{} has a different pixel layout, use a save instead\n", filename);
+        return false;
+    }
+    if (header.width != pixels.width() || header.height != pixels.height() || header.chunk_size != pixels.chunk_size()) {
+        std::print("{} is for a {}x{} world with {} pixel chunks\n", filename, header.width, header.height, header.chunk_size);
+        return false;
+    }
+
+    const auto num_chunks = pixels.get_chunks().size();
+    const auto num_pixels = pixels.storage().size();
+    if (header.pixels_offset != pixels_offset(num_chunks) || file->size() < header.pixels_offset + num_pixels * sizeof(pixel)) {
+        std::print("{} is truncated\n", filename);
+        return false;
+    }
+
+    auto storage = pixel_storage{std::move(*file), header.pixels_offset, num_pixels};
+    if (!valid_types(storage.pixels(), jobs)) {
+        std::print("{} is corrupt, it has pixels of unknown types\n", filename);
+        return false;
+    }
+
+    // The counts on disk are only as good as the last sync, so they come from the pixels
+    const auto chunks = read_chunk_table(*storage.file(), pixels);
+    pixels.adopt_storage(std::move(storage), chunks);
+    pixels.recount_chunks(jobs);
+
+    // Everything is as it is on disk, so only changes from now on are dirty
+    auto synced = header;
+    synced.synced_tick = pixels.tick();
+    write_header(*pixels.storage().file(), synced);
+    return true;
+}
+
+template <typename Geometry>
+auto sync_world_file(basic_world<Geometry>& pixels) -> bool
+{
+    const auto* file = pixels.storage().file();
+    if (!file) {
+        return false;
+    }
+
+    auto header = read_header(*file);
+    const auto chunk_bytes = static_cast<std::size_t>(pixels.chunk_area()) * sizeof(pixel);
+    auto ok = true;
+    for (std::size_t index = 0; index != pixels.get_chunks().size(); ++index) {
+        if (pixels.get_chunks()[index].modified_tick >= header.synced_tick) {
+            ok = file->flush(header.pixels_offset + index * chunk_bytes, chunk_bytes) && ok;
+        }
+    }
+
+    // The pixels are on disk before the header says they are synced
+    ok = file->commit() && ok;
+    write_chunk_table(*file, pixels);
+    header.synced_tick = pixels.tick();
+    write_header(*file, header);
+    return file->flush(0, header.pixels_offset) && file->commit() && ok;
+}
+
+template auto create_world_file(basic_world<sand::config::geometry>&, const std::string&) -> bool;
+template auto create_world_file(basic_world<dynamic_geometry>&, const std::string&) -> bool;
+template auto open_world_file(basic_world<sand::config::geometry>&, const std::string&, job_system&) -> bool;
+template auto open_world_file(basic_world<dynamic_geometry>&, const std::string&, job_system&) -> bool;
+template auto sync_world_file(basic_world<sand::config::geometry>&) -> bool;
+template auto sync_world_file(basic_world<dynamic_geometry>&) -> bool;
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "world.hpp"
+#include "job_system.hpp"
+
+#include <string>
+
+namespace sand {
+
+// World files are the working set format: the pixels exactly as they are in memory, so
+// a world can use a mapped file as its pixel storage instead of decoding a save. Opening
+// one is mapping it and reading each pixel once to check it, with no decoding, and syncing
+// flushes only the chunks that changed. The file is a header, a table of chunk states
+// and then, starting on a 64KiB boundary, the pixels chunk by chunk. It is only readable
+// by builds with the same pixel layout, which the header records; use the compressed
+// save format for anything that needs to last. Other processes can map a world file
+// read-only to inspect a running world.
+template <typename Geometry>
+auto create_world_file(basic_world<Geometry>& pixels, const std::string& filename) -> bool;
+
+// Returns false, leaving the world untouched, if the file can't be mapped, doesn't
+// match this world or holds a pixel type that doesn't exist. Every pixel is read once
+// to check its type and rebuild the chunk type counts, which are not trusted from disk.
+template <typename Geometry>
+auto open_world_file(basic_world<Geometry>& pixels, const std::string& filename, job_system& jobs) -> bool;
+
+// Writes the chunk states and flushes the chunks changed since the last sync. Returns
+// false if the world isn't backed by a file or the flush failed
+template <typename Geometry>
+auto sync_world_file(basic_world<Geometry>& pixels) -> bool;
+
+}